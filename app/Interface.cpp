@@ -5,7 +5,7 @@
 
 namespace mercury {
 
-	Description::Description(const sf::IntRect& boundingBox, tree::QuadTree* tree)
+	Description::Description(const sf::IntRect& boundingBox, tree::QuadTree<>* tree)
 		: m_box{ boundingBox }
 		, m_tree{ tree }
 	{
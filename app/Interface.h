@@ -1,16 +1,13 @@
 #pragma once
 #include "Node.h"
-
-namespace tree {
-	class QuadTree;
-}
+#include "QuadTree.h"
 
 namespace mercury {
 
 	class Description final : public Node {
 	public:
 
-		Description(const sf::IntRect& boundingBox, tree::QuadTree* tree);
+		Description(const sf::IntRect& boundingBox, tree::QuadTree<>* tree);
 
 		void Update(float dt) override;
 
@@ -21,7 +18,7 @@ namespace mercury {
 		void OnDraw(sf::RenderTarget& target, const sf::RenderStates& states) const override;
 
 		sf::IntRect m_box;
-		tree::QuadTree* const m_tree{ nullptr };
+		tree::QuadTree<>* const m_tree{ nullptr };
 		sf::Font m_font;
 		sf::Text m_header;
 		sf::Text m_mouse;
@@ -23,7 +23,7 @@ namespace mercury {
 
 	void MainScene::Init() {
 		mt::Rect rect{ 0.f, 0.f, 600.f, 600.f };
-		m_tree = std::make_unique<tree::QuadTree>(rect);
+		m_tree = std::make_unique<tree::QuadTree<>>(rect);
 		m_treeLayout = new QuadTreeLayout{ m_tree.get() };
 		this->AddChild(m_treeLayout);
 
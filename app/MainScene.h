@@ -1,13 +1,10 @@
 #pragma once
 #include "Node.h"
+#include "QuadTree.h"
 
 #include <functional>
 #include <memory>
 
-namespace tree {
-	class QuadTree;
-}
-
 namespace mercury {
 
 	class QuadTreeLayout;
@@ -36,7 +33,7 @@ namespace mercury {
 		bool m_isLocked{ false };
 		sf::Vector2f m_mouse{ 0.f, 0.f };
 
-		std::unique_ptr<tree::QuadTree> m_tree{ nullptr };
+		std::unique_ptr<tree::QuadTree<>> m_tree{ nullptr };
 		QuadTreeLayout *m_treeLayout{ nullptr };
 	};
 
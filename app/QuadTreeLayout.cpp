@@ -3,7 +3,7 @@
 
 namespace mercury {
 
-	QuadTreeLayout::QuadTreeLayout(tree::QuadTree* tree) 
+	QuadTreeLayout::QuadTreeLayout(tree::QuadTree<>* tree) 
 		: m_tree{ tree }
 	{
 		this->Init();
@@ -102,7 +102,7 @@ namespace mercury {
 	}
 
 	void QuadTreeLayout::AddTree() {
-		m_tree->PostOrderVisit([this](tree::Node::pointer& node) {
+		m_tree->PostOrderVisit([this](tree::QuadTree<>::Node::pointer& node) {
 			// add quad shape:
 			sf::RectangleShape shape;
 			shape.setFillColor(sf::Color::Transparent);
@@ -114,8 +114,8 @@ namespace mercury {
 			m_rects.push_back(shape);
 
 			// add points
-			for (const auto& point : node->m_data) {
-				m_marks->AddPoint({ point.x, point.y });
+			for (size_t i = 0; i < node->m_size; i++) {
+				m_marks->AddPoint({ node->m_xs[i], node->m_ys[i] });
 			}
 		});
 	}
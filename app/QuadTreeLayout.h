@@ -1,12 +1,9 @@
 #pragma once
 #include "Graphics.h"
+#include "QuadTree.h"
 #include <vector>
 #include <optional>
 
-namespace tree {
-	class QuadTree;
-}
-
 namespace mercury {
 
 	/**
@@ -22,7 +19,7 @@ namespace mercury {
 	class QuadTreeLayout : public Node {
 	public:
 
-		QuadTreeLayout(tree::QuadTree* tree);
+		QuadTreeLayout(tree::QuadTree<>* tree);
 
 		~QuadTreeLayout();
 
@@ -38,7 +35,7 @@ namespace mercury {
 
 		void OnDraw(sf::RenderTarget& target, const sf::RenderStates& states) const override;
 	
-		tree::QuadTree * const m_tree{ nullptr };
+		tree::QuadTree<> * const m_tree{ nullptr };
 		// marks keep points from the tree
 		Marks * m_marks{ nullptr };
 		std::vector<sf::RectangleShape> m_rects;
@@ -0,0 +1,138 @@
+#include "RegionQuadTree.h"
+#include "Points.h"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+
+namespace {
+
+	const mt::Rect FULL_AREA{ { 0.f, 0.f }, { bench::SIDE, bench::SIDE } };
+	// the largest side of a box and the largest distance it moves per frame
+	constexpr float MAX_SIDE{ 4.f };
+	constexpr float MAX_SPEED{ 1.f };
+
+	using Tree = tree::RegionQuadTree<>;
+
+	// moving boxes centered at the points of the distribution
+	struct World {
+		std::vector<mt::Rect> boxes;
+		std::vector<mt::Pt> velocities;
+
+		World(bench::Distribution distribution, size_t count) {
+			std::mt19937 generator{ 11 };
+			std::uniform_real_distribution<float> side{ MAX_SIDE / 8.f, MAX_SIDE };
+			std::uniform_real_distribution<float> speed{ -MAX_SPEED, MAX_SPEED };
+			for (const auto& center : bench::GeneratePoints(distribution, count, 3)) {
+				const mt::Size size{ side(generator), side(generator) };
+				boxes.push_back({ { center.x - size.width / 2.f, center.y - size.height / 2.f }, size });
+				velocities.push_back({ speed(generator), speed(generator) });
+			}
+		}
+
+		// move the boxes bouncing them off the boundary
+		void Step() {
+			for (size_t i = 0; i < boxes.size(); i++) {
+				auto& origin = boxes[i].origin;
+				auto& velocity = velocities[i];
+				origin.x += velocity.x;
+				origin.y += velocity.y;
+				if (origin.x < 0.f || origin.x + boxes[i].size.width > bench::SIDE) {
+					velocity.x = -velocity.x;
+				}
+				if (origin.y < 0.f || origin.y + boxes[i].size.height > bench::SIDE) {
+					velocity.y = -velocity.y;
+				}
+			}
+		}
+	};
+
+	size_t CountPairs(const Tree& tree) {
+		size_t pairs{ 0 };
+		tree.ForEachOverlappingPair([&pairs](tree::Handle, tree::Handle) {
+			pairs++;
+		});
+		return pairs;
+	}
+
+	// the tree is kept between frames: the boxes are moved in it
+	void BM_MoveFrame(benchmark::State& state) {
+		World world{ static_cast<bench::Distribution>(state.range(0)), static_cast<size_t>(state.range(1)) };
+		Tree tree{ FULL_AREA };
+		std::vector<tree::Handle> handles;
+		for (const auto& box : world.boxes) {
+			handles.push_back(tree.Insert(box));
+		}
+		for (auto _ : state) {
+			state.PauseTiming();
+			world.Step();
+			state.ResumeTiming();
+			for (size_t i = 0; i < handles.size(); i++) {
+				tree.Move(handles[i], world.boxes[i]);
+			}
+			benchmark::DoNotOptimize(CountPairs(tree));
+		}
+		state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * world.boxes.size()));
+	}
+
+	// the tree is built from scratch each frame
+	void BM_RebuildFrame(benchmark::State& state) {
+		World world{ static_cast<bench::Distribution>(state.range(0)), static_cast<size_t>(state.range(1)) };
+		Tree tree{ FULL_AREA };
+		for (auto _ : state) {
+			state.PauseTiming();
+			world.Step();
+			state.ResumeTiming();
+			tree.Clear();
+			for (const auto& box : world.boxes) {
+				tree.Insert(box);
+			}
+			benchmark::DoNotOptimize(CountPairs(tree));
+		}
+		state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * world.boxes.size()));
+	}
+
+	// the baseline: each pair of boxes is tested
+	void BM_BruteForceFrame(benchmark::State& state) {
+		World world{ static_cast<bench::Distribution>(state.range(0)), static_cast<size_t>(state.range(1)) };
+		for (auto _ : state) {
+			state.PauseTiming();
+			world.Step();
+			state.ResumeTiming();
+			size_t pairs{ 0 };
+			for (size_t i = 0; i < world.boxes.size(); i++) {
+				for (size_t j = i + 1; j < world.boxes.size(); j++) {
+					pairs += world.boxes[i].Intersect(world.boxes[j]);
+				}
+			}
+			benchmark::DoNotOptimize(pairs);
+		}
+		state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * world.boxes.size()));
+	}
+
+	void Frames(benchmark::internal::Benchmark* benchmark, std::initializer_list<int64_t> counts) {
+		benchmark->ArgNames({ "dist", "boxes" });
+		for (auto distribution : { bench::Distribution::UNIFORM, bench::Distribution::CLUSTERED }) {
+			for (auto count : counts) {
+				benchmark->Args({ static_cast<int64_t>(distribution), count });
+			}
+		}
+	}
+
+	void Scalable(benchmark::internal::Benchmark* benchmark) {
+		Frames(benchmark, { 10'000, 100'000 });
+	}
+
+	// quadratic: only the small counts
+	void Quadratic(benchmark::internal::Benchmark* benchmark) {
+		Frames(benchmark, { 10'000 });
+	}
+
+} // namespace {
+
+BENCHMARK(BM_MoveFrame)->Apply(Scalable)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RebuildFrame)->Apply(Scalable)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BruteForceFrame)->Apply(Quadratic)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
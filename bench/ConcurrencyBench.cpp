@@ -0,0 +1,154 @@
+#include "QuadTree.h"
+#include "SnapshotQuadTree.h"
+#include "ConcurrentQuadTree.h"
+#include "Points.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+	const mt::Rect FULL_AREA{ { 0.f, 0.f }, { bench::SIDE, bench::SIDE } };
+	constexpr size_t POINTS{ 100'000 };
+	constexpr size_t QUERIES{ 1024 };
+	// side of the query is 1/64 of the side of the tree
+	constexpr float QUERY_SIDE{ bench::SIDE / 64.f };
+
+	/**
+	 * The first thread modifies the tree erasing and inserting points back,
+	 * the rest of threads query it. Reported rate is the number of queries.
+	 * The tree is created by the first thread before the loop and destroyed after it:
+	 * google benchmark synchronizes threads at the both points.
+	 */
+	template<class Tree, class Read, class Write>
+	void ReadWhileWriting(benchmark::State& state, std::unique_ptr<Tree>& tree, Read&& read, Write&& write) {
+		static const auto points = bench::GeneratePoints(bench::Distribution::UNIFORM, POINTS, 1);
+		static const auto areas = bench::GenerateAreas(QUERIES, QUERY_SIDE, 5);
+
+		if (state.thread_index() == 0) {
+			tree = std::make_unique<Tree>(FULL_AREA);
+			for (const auto& point : points) {
+				tree->Insert(point);
+			}
+		}
+
+		size_t index{ static_cast<size_t>(state.thread_index()) * 7 };
+		for (auto _ : state) {
+			if (state.thread_index() == 0 && state.threads() > 1) {
+				write(*tree, points[index++ % points.size()]);
+			}
+			else {
+				benchmark::DoNotOptimize(read(*tree, areas[index++ % QUERIES]));
+			}
+		}
+
+		if (state.thread_index() != 0 || state.threads() == 1) {
+			state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+		}
+		if (state.thread_index() == 0) {
+			tree.reset();
+		}
+	}
+
+	// the tree shared by the threads under the lock
+	struct LockedTree {
+		explicit LockedTree(const mt::Rect& area)
+			: tree{ area }
+		{}
+
+		void Insert(const mt::Pt& point) {
+			std::lock_guard<std::mutex> lock{ mutex };
+			tree.Insert(point);
+		}
+
+		std::vector<mt::Pt> GetPointsAt(const mt::Rect& area) {
+			std::lock_guard<std::mutex> lock{ mutex };
+			return tree.GetPointsAt(area);
+		}
+
+		std::mutex mutex;
+		tree::QuadTree<> tree;
+	};
+
+	void BM_LockedReaders(benchmark::State& state) {
+		static std::unique_ptr<LockedTree> tree;
+		ReadWhileWriting(state, tree,
+			[](LockedTree& locked, const mt::Rect& area) {
+				std::lock_guard<std::mutex> lock{ locked.mutex };
+				return locked.tree.GetPointsAt(area).size();
+			},
+			[](LockedTree& locked, const mt::Pt& point) {
+				std::lock_guard<std::mutex> lock{ locked.mutex };
+				locked.tree.Erase(point);
+				locked.tree.Insert(point);
+			}
+		);
+	}
+
+	void BM_SnapshotReaders(benchmark::State& state) {
+		using Tree = tree::SnapshotQuadTree<>;
+		static std::unique_ptr<Tree> tree;
+		ReadWhileWriting(state, tree,
+			[](Tree& snapshots, const mt::Rect& area) {
+				return snapshots.GetSnapshot().GetPointsAt(area).size();
+			},
+			[](Tree& snapshots, const mt::Pt& point) {
+				snapshots.Erase(point);
+				snapshots.Insert(point);
+			}
+		);
+	}
+
+	/**
+	 * The points are inserted into the new tree by `state.range(0)` threads,
+	 * each of them inserts its share of points. Reported rate is the number of inserted points.
+	 */
+	template<class Tree>
+	void InsertInParallel(benchmark::State& state) {
+		static const auto points = bench::GeneratePoints(bench::Distribution::UNIFORM, 1'000'000, 1);
+		const auto threads = static_cast<size_t>(state.range(0));
+		const size_t share = (points.size() + threads - 1) / threads;
+
+		for (auto _ : state) {
+			Tree tree{ FULL_AREA };
+			std::vector<std::thread> inserters;
+			for (size_t thread = 0; thread < threads; thread++) {
+				inserters.emplace_back([&tree, &share, thread]() {
+					const size_t last = std::min(points.size(), (thread + 1) * share);
+					for (size_t i = thread * share; i < last; i++) {
+						tree.Insert(points[i]);
+					}
+				});
+			}
+			for (auto& inserter : inserters) {
+				inserter.join();
+			}
+			state.PauseTiming();
+			benchmark::DoNotOptimize(tree.GetPointsAt(FULL_AREA).size());
+			state.ResumeTiming();
+		}
+		state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * points.size()));
+	}
+
+	void BM_LockedInsert(benchmark::State& state) {
+		InsertInParallel<LockedTree>(state);
+	}
+
+	void BM_ConcurrentInsert(benchmark::State& state) {
+		InsertInParallel<tree::ConcurrentQuadTree<>>(state);
+	}
+
+} // namespace {
+
+// one thread is the writer when there are several of them
+BENCHMARK(BM_LockedReaders)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BM_SnapshotReaders)->ThreadRange(1, 16)->UseRealTime();
+// the argument is the number of inserting threads
+BENCHMARK(BM_LockedInsert)->RangeMultiplier(2)->Range(1, 32)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ConcurrentInsert)->RangeMultiplier(2)->Range(1, 32)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,113 @@
+#include "Memory.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+	#define NOMINMAX
+	#include <windows.h>
+	#include <psapi.h>
+#else
+	#include <sys/resource.h>
+#endif
+
+namespace {
+
+	std::atomic<bool> counting{ false };
+	std::atomic<size_t> allocations{ 0 };
+	std::atomic<size_t> liveBytes{ 0 };
+	std::atomic<size_t> peakBytes{ 0 };
+
+	// the size of the block is kept before it to be known on deallocation
+	constexpr size_t HEADER{ alignof(std::max_align_t) };
+
+	void* Allocate(size_t size) {
+		auto block = static_cast<unsigned char*>(std::malloc(size + HEADER));
+		if (block == nullptr) {
+			throw std::bad_alloc{};
+		}
+		*reinterpret_cast<size_t*>(block) = size;
+		if (counting.load(std::memory_order_relaxed)) {
+			allocations.fetch_add(1, std::memory_order_relaxed);
+		}
+		const size_t live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+		size_t peak = peakBytes.load(std::memory_order_relaxed);
+		while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+		}
+		return block + HEADER;
+	}
+
+	void Deallocate(void* pointer) noexcept {
+		if (pointer == nullptr) {
+			return;
+		}
+		auto block = static_cast<unsigned char*>(pointer) - HEADER;
+		liveBytes.fetch_sub(*reinterpret_cast<size_t*>(block), std::memory_order_relaxed);
+		std::free(block);
+	}
+
+} // namespace {
+
+void* operator new(size_t size) {
+	return Allocate(size);
+}
+
+void* operator new[](size_t size) {
+	return Allocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+	Deallocate(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+	Deallocate(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+	Deallocate(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+	Deallocate(pointer);
+}
+
+namespace bench {
+
+	HeapStats GetHeapStats() noexcept {
+		HeapStats stats;
+		stats.allocations = allocations.load();
+		stats.liveBytes = liveBytes.load();
+		stats.peakBytes = peakBytes.load();
+		return stats;
+	}
+
+	void EnableCounting(bool enable) noexcept {
+		counting = enable;
+	}
+
+	void ResetPeak() noexcept {
+		peakBytes = liveBytes.load();
+	}
+
+	size_t GetPeakRss() noexcept {
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+			return counters.PeakWorkingSetSize;
+		}
+		return 0;
+#else
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+	#if defined(__APPLE__)
+		return static_cast<size_t>(usage.ru_maxrss);
+	#else
+		// kilobytes on Linux
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+	#endif
+#endif
+	}
+
+} // namespace bench
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+namespace bench {
+
+	/**
+	 * Heap usage of the process tracked by the replaced global operator new/delete.
+	 * Allocations are counted only while counting is enabled,
+	 * so the setup of a benchmark doesn't affect the result.
+	 */
+	struct HeapStats {
+		size_t allocations{ 0 };
+		// bytes allocated but not freed yet
+		size_t liveBytes{ 0 };
+		// maximum of `liveBytes` since the last `ResetPeak`
+		size_t peakBytes{ 0 };
+	};
+
+	HeapStats GetHeapStats() noexcept;
+
+	void EnableCounting(bool enable) noexcept;
+
+	// start tracking the peak from the current heap usage
+	void ResetPeak() noexcept;
+
+	// peak resident set size of the process in bytes
+	size_t GetPeakRss() noexcept;
+
+} // namespace bench
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "healthy.h"
+
+#include <random>
+#include <vector>
+#include <string>
+
+namespace bench {
+
+	// side of the square area covered by the generated points
+	constexpr float SIDE{ 1024.f };
+
+	enum class Distribution {
+		// uniform over the whole area
+		UNIFORM,
+		// a few Gaussian blobs
+		CLUSTERED,
+		// all points on the horizontal line
+		LINE,
+		COUNT
+	};
+
+	inline std::string GetName(Distribution distribution) {
+		switch (distribution) {
+		case Distribution::UNIFORM: return "uniform";
+		case Distribution::CLUSTERED: return "clustered";
+		case Distribution::LINE: return "line";
+		default: return "unknown";
+		}
+	}
+
+	inline std::vector<mt::Pt> GeneratePoints(Distribution distribution, size_t count, uint32_t seed) {
+		constexpr size_t BLOBS{ 16 };
+		constexpr float SPREAD{ SIDE / 64.f };
+
+		std::mt19937 generator{ seed };
+		std::uniform_real_distribution<float> coordinate{ 0.f, SIDE };
+		std::vector<mt::Pt> centers(BLOBS);
+		for (auto& center : centers) {
+			center = { coordinate(generator), coordinate(generator) };
+		}
+		std::normal_distribution<float> offset{ 0.f, SPREAD };
+		std::uniform_int_distribution<size_t> blob{ 0, BLOBS - 1 };
+
+		std::vector<mt::Pt> points;
+		points.reserve(count);
+		while (points.size() < count) {
+			mt::Pt point;
+			switch (distribution) {
+			case Distribution::CLUSTERED: {
+				const auto& center = centers[blob(generator)];
+				point = { center.x + offset(generator), center.y + offset(generator) };
+			} break;
+			case Distribution::LINE:
+				point = { coordinate(generator), SIDE / 2.f };
+				break;
+			default:
+				point = { coordinate(generator), coordinate(generator) };
+				break;
+			}
+			// keep the points of the blobs inside of the area
+			if (point.x >= 0.f && point.x < SIDE && point.y >= 0.f && point.y < SIDE) {
+				points.push_back(point);
+			}
+		}
+		return points;
+	}
+
+	// square areas with the given side placed uniformly
+	inline std::vector<mt::Rect> GenerateAreas(size_t count, float side, uint32_t seed) {
+		std::mt19937 generator{ seed };
+		std::uniform_real_distribution<float> coordinate{ 0.f, SIDE - side };
+		std::vector<mt::Rect> areas;
+		areas.reserve(count);
+		for (size_t i = 0; i < count; i++) {
+			areas.push_back({ { coordinate(generator), coordinate(generator) }, { side, side } });
+		}
+		return areas;
+	}
+
+} // namespace bench
@@ -0,0 +1,680 @@
+#include "QuadTree.h"
+#include "LinearQuadTree.h"
+#include "Aggregates.h"
+#include "FlatQuadTree.h"
+#include "FlatTreeBuilder.h"
+#include "Points.h"
+#include "Memory.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+	using Tree = tree::QuadTree<>;
+	using LinearTree = tree::LinearQuadTree<>;
+	using Centroid = tree::CentroidAggregate<float>;
+	using CentroidTree = tree::QuadTree<tree::NoPayload, float, tree::DEFAULT_LEAF_CAPACITY, Centroid>;
+	using bench::Distribution;
+
+	const mt::Rect FULL_AREA{ { 0.f, 0.f }, { bench::SIDE, bench::SIDE } };
+	// number of different queries each of query benchmarks cycles through
+	constexpr size_t QUERIES{ 1024 };
+
+	/**
+	 * Collect operations, allocations and the peak of heap usage of the timed part of the benchmark.
+	 * Everything done while the measure is paused is ignored.
+	 */
+	class Measure {
+	public:
+		explicit Measure(benchmark::State& state)
+			: m_state{ state }
+		{
+			bench::ResetPeak();
+			m_start = bench::GetHeapStats();
+			bench::EnableCounting(true);
+		}
+
+		~Measure() {
+			bench::EnableCounting(false);
+		}
+
+		void Pause() {
+			bench::EnableCounting(false);
+			m_state.PauseTiming();
+		}
+
+		void Resume() {
+			m_state.ResumeTiming();
+			bench::EnableCounting(true);
+		}
+
+		// report the counters: `operations` is the number of operations done by all of iterations
+		void Finish(size_t operations) {
+			bench::EnableCounting(false);
+			const auto stats = bench::GetHeapStats();
+			const auto ops = static_cast<double>(std::max(operations, size_t{ 1 }));
+
+			using benchmark::Counter;
+			m_state.counters["time/op"] = Counter(ops, Counter::kIsRate | Counter::kInvert);
+			m_state.counters["allocs/op"] = Counter(static_cast<double>(stats.allocations - m_start.allocations) / ops);
+			m_state.counters["peak_heap"] = Counter(
+				static_cast<double>(stats.peakBytes - std::min(stats.peakBytes, m_start.liveBytes)),
+				Counter::kDefaults, Counter::kIs1024
+			);
+			m_state.counters["peak_rss"] = Counter(static_cast<double>(bench::GetPeakRss()), Counter::kDefaults, Counter::kIs1024);
+		}
+
+	private:
+		benchmark::State& m_state;
+		bench::HeapStats m_start;
+	};
+
+	struct Input {
+		Distribution distribution{ Distribution::COUNT };
+		size_t count{ 0 };
+		std::vector<mt::Pt> points;
+		std::unique_ptr<Tree> tree;
+		std::unique_ptr<LinearTree> linear;
+	};
+
+	/**
+	 * Return the points of the distribution and the trees built from them.
+	 * Only the last input is kept: benchmarks of the same input run one after another.
+	 */
+	const Input& GetInput(const benchmark::State& state, bool withTree, bool withLinear = false) {
+		static Input input;
+
+		const auto distribution = static_cast<Distribution>(state.range(0));
+		const auto count = static_cast<size_t>(state.range(1));
+		if (input.distribution != distribution || input.count != count) {
+			input.tree.reset();
+			input.linear.reset();
+			input.distribution = distribution;
+			input.count = count;
+			input.points = bench::GeneratePoints(distribution, count, 1);
+		}
+		if (withTree && !input.tree) {
+			input.tree = std::make_unique<Tree>(FULL_AREA);
+			input.tree->Build(input.points);
+		}
+		if (withLinear && !input.linear) {
+			input.linear = std::make_unique<LinearTree>(FULL_AREA);
+			input.linear->Build(input.points);
+		}
+		return input;
+	}
+
+	void BM_Insert(benchmark::State& state) {
+		const auto& points = GetInput(state, false).points;
+
+		Measure measure{ state };
+		for (auto _ : state) {
+			auto tree = std::make_unique<Tree>(FULL_AREA);
+			for (const auto& point : points) {
+				tree->Insert(point);
+			}
+			measure.Pause();
+			tree.reset();
+			measure.Resume();
+		}
+		measure.Finish(state.iterations() * points.size());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	void BM_Build(benchmark::State& state) {
+		const auto& points = GetInput(state, false).points;
+
+		Measure measure{ state };
+		for (auto _ : state) {
+			auto tree = std::make_unique<Tree>(FULL_AREA);
+			tree->Build(points);
+			measure.Pause();
+			tree.reset();
+			measure.Resume();
+		}
+		measure.Finish(state.iterations() * points.size());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	// the same as `BM_Build` for the nodes in one array: compare the peak of heap usage
+	void BM_LinearBuild(benchmark::State& state) {
+		const auto& points = GetInput(state, false).points;
+
+		Measure measure{ state };
+		for (auto _ : state) {
+			auto tree = std::make_unique<LinearTree>(FULL_AREA);
+			tree->Build(points);
+			measure.Pause();
+			tree.reset();
+			measure.Resume();
+		}
+		measure.Finish(state.iterations() * points.size());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	// return the file of the flat tree written from the tree of the input
+	std::string WriteFlat(const Input& input) {
+		const auto path = (std::filesystem::temp_directory_path() / "qtree_bench.flat").string();
+		tree::FlatQuadTree<>::Write(*input.tree, path);
+		return path;
+	}
+
+	/**
+	 * Cold start from the file: map the flat tree and answer one query.
+	 * The third argument is whether the checksum is verified.
+	 */
+	void BM_FlatOpen(benchmark::State& state) {
+		const auto& input = GetInput(state, true);
+		const auto path = WriteFlat(input);
+		const bool verify = state.range(2) != 0;
+		const mt::Rect area{ { 0.f, 0.f }, { bench::SIDE / 64.f, bench::SIDE / 64.f } };
+
+		Measure measure{ state };
+		for (auto _ : state) {
+			tree::FlatQuadTree<> flat;
+			if (flat.Open(path, verify) != tree::FlatStatus::OK) {
+				state.SkipWithError("The flat tree can't be opened");
+				break;
+			}
+			benchmark::DoNotOptimize(flat.CountPointsAt(area));
+		}
+		measure.Finish(state.iterations());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+		std::remove(path.c_str());
+	}
+
+	/**
+	 * Build the flat tree on disk with the memory limit of 1/8 of the size of the points.
+	 * The peak of heap usage stays near the limit whatever the number of points.
+	 */
+	void BM_FlatBuild(benchmark::State& state) {
+		const auto& points = GetInput(state, false).points;
+		const auto path = (std::filesystem::temp_directory_path() / "qtree_bench_built.flat").string();
+		tree::FlatBuildOptions options;
+		options.memoryLimit = std::max(points.size() * sizeof(mt::Pt) / 8, size_t{ 1 } << 16);
+
+		Measure measure{ state };
+		for (auto _ : state) {
+			tree::FlatTreeBuilder<> builder{ FULL_AREA, options };
+			builder.Add(points);
+			if (builder.Finish(path) != tree::FlatStatus::OK) {
+				state.SkipWithError("The flat tree can't be built");
+				break;
+			}
+		}
+		measure.Finish(state.iterations() * points.size());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+		std::remove(path.c_str());
+	}
+
+	void BM_Erase(benchmark::State& state) {
+		auto points = GetInput(state, false).points;
+		std::shuffle(points.begin(), points.end(), std::mt19937{ 2 });
+
+		Measure measure{ state };
+		for (auto _ : state) {
+			measure.Pause();
+			auto tree = std::make_unique<Tree>(FULL_AREA);
+			tree->Build(points);
+			measure.Resume();
+			for (const auto& point : points) {
+				tree->Erase(point);
+			}
+			measure.Pause();
+			tree.reset();
+			measure.Resume();
+		}
+		measure.Finish(state.iterations() * points.size());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	// the third argument tells whether the tree keeps the location index
+	void BM_Contains(benchmark::State& state) {
+		const auto& input = GetInput(state, true);
+		input.tree->SetLocationIndex(state.range(2) != 0);
+		// a half of queries hits the stored points
+		auto queries = bench::GeneratePoints(Distribution::UNIFORM, QUERIES, 3);
+		std::mt19937 generator{ 4 };
+		for (size_t i = 0; i < queries.size(); i += 2) {
+			queries[i] = input.points[generator() % input.points.size()];
+		}
+
+		Measure measure{ state };
+		size_t query{ 0 };
+		for (auto _ : state) {
+			benchmark::DoNotOptimize(input.tree->Contains(queries[query++ % QUERIES]));
+		}
+		measure.Finish(state.iterations());
+		input.tree->SetLocationIndex(false);
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	// the third argument is the ratio of the side of the whole area to the side of the query
+	void BM_GetPointsAt(benchmark::State& state) {
+		const auto& input = GetInput(state, true);
+		const auto areas = bench::GenerateAreas(QUERIES, bench::SIDE / static_cast<float>(state.range(2)), 5);
+
+		Measure measure{ state };
+		size_t query{ 0 };
+		for (auto _ : state) {
+			benchmark::DoNotOptimize(input.tree->GetPointsAt(areas[query++ % QUERIES]));
+		}
+		measure.Finish(state.iterations());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	// the same queries as `BM_GetPointsAt` over the nodes in one array
+	void BM_LinearGetPointsAt(benchmark::State& state) {
+		const auto& input = GetInput(state, false, true);
+		const auto areas = bench::GenerateAreas(QUERIES, bench::SIDE / static_cast<float>(state.range(2)), 5);
+
+		Measure measure{ state };
+		size_t query{ 0 };
+		for (auto _ : state) {
+			benchmark::DoNotOptimize(input.linear->GetPointsAt(areas[query++ % QUERIES]));
+		}
+		measure.Finish(state.iterations());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	void BM_ForEachAt(benchmark::State& state) {
+		const auto& input = GetInput(state, true);
+		const auto areas = bench::GenerateAreas(QUERIES, bench::SIDE / static_cast<float>(state.range(2)), 5);
+
+		Measure measure{ state };
+		size_t query{ 0 };
+		size_t found{ 0 };
+		for (auto _ : state) {
+			input.tree->ForEachAt(areas[query++ % QUERIES], [&found](const mt::Pt&, const tree::NoPayload&, tree::Handle) {
+				found++;
+			});
+		}
+		benchmark::DoNotOptimize(found);
+		measure.Finish(state.iterations());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	// the circles are inscribed in the areas, the fourth argument tells whether the area is queried and filtered instead
+	void BM_GetPointsInCircle(benchmark::State& state) {
+		const auto& input = GetInput(state, true);
+		const auto areas = bench::GenerateAreas(QUERIES, bench::SIDE / static_cast<float>(state.range(2)), 5);
+		const bool filter = state.range(3) != 0;
+
+		Measure measure{ state };
+		size_t query{ 0 };
+		std::vector<mt::Pt> points;
+		for (auto _ : state) {
+			const auto& area = areas[query++ % QUERIES];
+			const auto center = area.GetMid();
+			const float radius = area.size.width / 2.f;
+			points.clear();
+			if (filter) {
+				input.tree->GetPointsAt(area, std::back_inserter(points));
+				points.erase(std::remove_if(points.begin(), points.end(), [&center, radius](const mt::Pt& point) {
+					const float dx = point.x - center.x;
+					const float dy = point.y - center.y;
+					return dx * dx + dy * dy > radius * radius;
+				}), points.end());
+			}
+			else {
+				input.tree->GetPointsInCircle(center, radius, std::back_inserter(points));
+			}
+			benchmark::DoNotOptimize(points.data());
+		}
+		measure.Finish(state.iterations());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	// the hexagons are inscribed in the areas, the fourth argument tells whether the area is queried and filtered instead
+	void BM_GetPointsInPolygon(benchmark::State& state) {
+		const auto& input = GetInput(state, true);
+		const auto areas = bench::GenerateAreas(QUERIES, bench::SIDE / static_cast<float>(state.range(2)), 5);
+		const bool filter = state.range(3) != 0;
+		std::vector<std::array<mt::Pt, 6>> hexagons;
+		for (const auto& area : areas) {
+			const float x = area.GetMinX();
+			const float y = area.GetMinY();
+			const float side = area.size.width;
+			hexagons.push_back({ {
+				{ x + side / 4.f, y }, { x + side * 3.f / 4.f, y }, { x + side, y + side / 2.f },
+				{ x + side * 3.f / 4.f, y + side }, { x + side / 4.f, y + side }, { x, y + side / 2.f }
+			} });
+		}
+
+		Measure measure{ state };
+		size_t query{ 0 };
+		std::vector<mt::Pt> points;
+		for (auto _ : state) {
+			const auto index = query++ % QUERIES;
+			const auto& hexagon = hexagons[index];
+			points.clear();
+			if (filter) {
+				input.tree->GetPointsAt(areas[index], std::back_inserter(points));
+				points.erase(std::remove_if(points.begin(), points.end(), [&hexagon](const mt::Pt& point) {
+					return !tree::detail::IsInPolygon(point, hexagon.data(), hexagon.size());
+				}), points.end());
+			}
+			else {
+				input.tree->GetPointsInPolygon(hexagon.data(), hexagon.size(), std::back_inserter(points));
+			}
+			benchmark::DoNotOptimize(points.data());
+		}
+		measure.Finish(state.iterations());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	void BM_CountPointsAt(benchmark::State& state) {
+		const auto& input = GetInput(state, true);
+		const auto areas = bench::GenerateAreas(QUERIES, bench::SIDE / static_cast<float>(state.range(2)), 5);
+
+		Measure measure{ state };
+		size_t query{ 0 };
+		for (auto _ : state) {
+			benchmark::DoNotOptimize(input.tree->CountPointsAt(areas[query++ % QUERIES]));
+		}
+		measure.Finish(state.iterations());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	// the centroid of the points in the area from the statistics of the subtrees
+	void BM_Reduce(benchmark::State& state) {
+		const auto& input = GetInput(state, false);
+		const auto areas = bench::GenerateAreas(QUERIES, bench::SIDE / static_cast<float>(state.range(2)), 5);
+		CentroidTree centroids{ FULL_AREA };
+		centroids.Build(input.points);
+
+		Measure measure{ state };
+		size_t query{ 0 };
+		for (auto _ : state) {
+			benchmark::DoNotOptimize(centroids.Reduce(areas[query++ % QUERIES]));
+		}
+		measure.Finish(state.iterations());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	// the same centroid accumulated over the points reported by `ForEachAt`
+	void BM_ReduceByVisit(benchmark::State& state) {
+		const auto& input = GetInput(state, true);
+		const auto areas = bench::GenerateAreas(QUERIES, bench::SIDE / static_cast<float>(state.range(2)), 5);
+
+		Measure measure{ state };
+		size_t query{ 0 };
+		for (auto _ : state) {
+			Centroid::Value centroid{};
+			input.tree->ForEachAt(areas[query++ % QUERIES], [&centroid](const mt::Pt& point, const auto& value, auto) {
+				centroid = Centroid::Combine(centroid, Centroid::Make(point, value));
+			});
+			benchmark::DoNotOptimize(centroid);
+		}
+		measure.Finish(state.iterations());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	void BM_FlatGetPointsAt(benchmark::State& state) {
+		const auto& input = GetInput(state, true);
+		const auto areas = bench::GenerateAreas(QUERIES, bench::SIDE / static_cast<float>(state.range(2)), 5);
+		const auto path = WriteFlat(input);
+		tree::FlatQuadTree<> flat;
+		flat.Open(path);
+
+		Measure measure{ state };
+		size_t query{ 0 };
+		for (auto _ : state) {
+			benchmark::DoNotOptimize(flat.GetPointsAt(areas[query++ % QUERIES]));
+		}
+		measure.Finish(state.iterations());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+		flat.Close();
+		std::remove(path.c_str());
+	}
+
+	// the area covers the whole tree, the third argument is the number of threads (0 for sequential query)
+	void BM_WholeMap(benchmark::State& state) {
+		const auto& input = GetInput(state, true);
+		const auto threads = static_cast<size_t>(state.range(2));
+		std::unique_ptr<tree::ThreadPool> pool;
+		if (threads > 0) {
+			pool = std::make_unique<tree::ThreadPool>(threads);
+		}
+
+		Measure measure{ state };
+		for (auto _ : state) {
+			if (pool) {
+				benchmark::DoNotOptimize(input.tree->GetPointsAt(FULL_AREA, *pool));
+			}
+			else {
+				benchmark::DoNotOptimize(input.tree->GetPointsAt(FULL_AREA));
+			}
+		}
+		measure.Finish(state.iterations());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	void BM_FindClosest(benchmark::State& state) {
+		const auto& input = GetInput(state, true);
+		const auto queries = bench::GeneratePoints(Distribution::UNIFORM, QUERIES, 6);
+
+		Measure measure{ state };
+		size_t query{ 0 };
+		for (auto _ : state) {
+			benchmark::DoNotOptimize(input.tree->FindClosest(queries[query++ % QUERIES]));
+		}
+		measure.Finish(state.iterations());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	/**
+	 * Points move by a small step like entities do every tick.
+	 * The points are moved in turn, a move to the taken position is skipped.
+	 */
+	template<class MoveFunc>
+	void MovePoints(benchmark::State& state, MoveFunc&& move) {
+		auto points = GetInput(state, false).points;
+		Tree tree{ FULL_AREA };
+		tree.Build(points);
+		std::mt19937 generator{ 7 };
+		std::uniform_real_distribution<float> step{ -0.5f, 0.5f };
+		std::vector<mt::Pt> steps(QUERIES);
+		for (auto& delta : steps) {
+			delta = { step(generator), step(generator) };
+		}
+
+		Measure measure{ state };
+		size_t index{ 0 };
+		for (auto _ : state) {
+			auto& point = points[index % points.size()];
+			const auto& delta = steps[index % QUERIES];
+			const mt::Pt next{
+				std::clamp(point.x + delta.x, 0.f, bench::SIDE - 1.f),
+				std::clamp(point.y + delta.y, 0.f, bench::SIDE - 1.f)
+			};
+			if (move(tree, point, next)) {
+				point = next;
+			}
+			index++;
+		}
+		measure.Finish(state.iterations());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	void BM_Move(benchmark::State& state) {
+		MovePoints(state, [](Tree& tree, const mt::Pt& from, const mt::Pt& to) {
+			return tree.Move(from, to);
+		});
+	}
+
+	// the baseline for `Move`
+	void BM_EraseInsert(benchmark::State& state) {
+		MovePoints(state, [](Tree& tree, const mt::Pt& from, const mt::Pt& to) {
+			if (tree.Contains(to)) {
+				return false;
+			}
+			tree.Erase(from);
+			tree.Insert(to);
+			return true;
+		});
+	}
+
+	// points are erased and inserted back, the third argument is tree::MergePolicy
+	void BM_Churn(benchmark::State& state) {
+		const auto& points = GetInput(state, false).points;
+		Tree tree{ FULL_AREA };
+		tree.SetMergePolicy(static_cast<tree::MergePolicy>(state.range(2)));
+		tree.Build(points);
+
+		Measure measure{ state };
+		size_t index{ 0 };
+		for (auto _ : state) {
+			const auto& point = points[index++ % points.size()];
+			tree.Erase(point);
+			tree.Insert(point);
+		}
+		measure.Finish(state.iterations());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	// the tree is cleared and filled again each frame: the nodes of the previous frame are reused
+	void BM_Frame(benchmark::State& state) {
+		const auto& points = GetInput(state, false).points;
+		Tree tree{ FULL_AREA };
+		for (const auto& point : points) {
+			tree.Insert(point);
+		}
+
+		Measure measure{ state };
+		for (auto _ : state) {
+			tree.Clear();
+			for (const auto& point : points) {
+				tree.Insert(point);
+			}
+		}
+		measure.Finish(state.iterations() * points.size());
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	size_t GetDepth(const Tree::Node* node) {
+		size_t depth{ 0 };
+		for (const auto child : node->m_children) {
+			if (child) {
+				depth = std::max(depth, GetDepth(child) + 1);
+			}
+		}
+		return depth;
+	}
+
+	// points are inserted and looked up, the third argument is tree::SplitPolicy
+	void BM_SplitPolicy(benchmark::State& state) {
+		const auto& points = GetInput(state, false).points;
+		const auto policy = static_cast<tree::SplitPolicy>(state.range(2));
+
+		Measure measure{ state };
+		size_t depth{ 0 };
+		for (auto _ : state) {
+			Tree tree{ FULL_AREA };
+			tree.SetSplitPolicy(policy);
+			for (const auto& point : points) {
+				tree.Insert(point);
+			}
+			for (const auto& point : points) {
+				benchmark::DoNotOptimize(tree.Contains(point));
+			}
+			measure.Pause();
+			// the root is visited first
+			tree.PreOrderVisit([&depth, root = true](Tree::Node* node) mutable {
+				if (std::exchange(root, false)) {
+					depth = GetDepth(node);
+				}
+			});
+			measure.Resume();
+		}
+		measure.Finish(state.iterations() * points.size());
+		state.counters["depth"] = static_cast<double>(depth);
+		state.SetLabel(bench::GetName(static_cast<Distribution>(state.range(0))));
+	}
+
+	const std::vector<int64_t> DISTRIBUTIONS{
+		static_cast<int64_t>(Distribution::UNIFORM),
+		static_cast<int64_t>(Distribution::CLUSTERED),
+		static_cast<int64_t>(Distribution::LINE)
+	};
+	const std::vector<int64_t> SIZES{ 1'000, 10'000, 100'000, 1'000'000, 10'000'000 };
+	// small and large queries
+	const std::vector<int64_t> QUERY_RATIOS{ 256, 16 };
+
+	void Inputs(benchmark::internal::Benchmark* benchmark) {
+		benchmark->ArgNames({ "dist", "points" })->ArgsProduct({ DISTRIBUTIONS, SIZES });
+	}
+
+	void Verifications(benchmark::internal::Benchmark* benchmark) {
+		benchmark->ArgNames({ "dist", "points", "verify" })->ArgsProduct({ DISTRIBUTIONS, SIZES, { 0, 1 } });
+	}
+
+	void Policies(benchmark::internal::Benchmark* benchmark) {
+		benchmark->ArgNames({ "dist", "points", "policy" })->ArgsProduct({ DISTRIBUTIONS, SIZES, {
+			static_cast<int64_t>(tree::MergePolicy::EAGER),
+			static_cast<int64_t>(tree::MergePolicy::LOW_WATER),
+			static_cast<int64_t>(tree::MergePolicy::DEFERRED)
+		} });
+	}
+
+	void Splits(benchmark::internal::Benchmark* benchmark) {
+		benchmark->ArgNames({ "dist", "points", "policy" })->ArgsProduct({ DISTRIBUTIONS, SIZES, {
+			static_cast<int64_t>(tree::SplitPolicy::MIDPOINT),
+			static_cast<int64_t>(tree::SplitPolicy::MEDIAN)
+		} });
+	}
+
+	void Locations(benchmark::internal::Benchmark* benchmark) {
+		benchmark->ArgNames({ "dist", "points", "index" })->ArgsProduct({ DISTRIBUTIONS, SIZES, { 0, 1 } });
+	}
+
+	void Shapes(benchmark::internal::Benchmark* benchmark) {
+		benchmark->ArgNames({ "dist", "points", "ratio", "filter" })->ArgsProduct({ DISTRIBUTIONS, SIZES, QUERY_RATIOS, { 0, 1 } });
+	}
+
+	void Threads(benchmark::internal::Benchmark* benchmark) {
+		benchmark->ArgNames({ "dist", "points", "threads" })->ArgsProduct({ DISTRIBUTIONS, { 1'000'000, 10'000'000 }, {
+			0, 1, 2, 4, 8, 16
+		} });
+	}
+
+	void Queries(benchmark::internal::Benchmark* benchmark) {
+		benchmark->ArgNames({ "dist", "points", "ratio" })->ArgsProduct({ DISTRIBUTIONS, SIZES, QUERY_RATIOS });
+	}
+
+} // namespace {
+
+BENCHMARK(BM_Insert)->Apply(Inputs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Build)->Apply(Inputs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LinearBuild)->Apply(Inputs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_FlatBuild)->Apply(Inputs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_FlatOpen)->Apply(Verifications)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Erase)->Apply(Inputs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Contains)->Apply(Locations);
+BENCHMARK(BM_GetPointsAt)->Apply(Queries);
+BENCHMARK(BM_LinearGetPointsAt)->Apply(Queries);
+BENCHMARK(BM_FlatGetPointsAt)->Apply(Queries);
+BENCHMARK(BM_ForEachAt)->Apply(Queries);
+BENCHMARK(BM_GetPointsInCircle)->Apply(Shapes);
+BENCHMARK(BM_GetPointsInPolygon)->Apply(Shapes);
+BENCHMARK(BM_CountPointsAt)->Apply(Queries);
+BENCHMARK(BM_Reduce)->Apply(Queries);
+BENCHMARK(BM_ReduceByVisit)->Apply(Queries);
+BENCHMARK(BM_WholeMap)->Apply(Threads)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_FindClosest)->Apply(Inputs);
+BENCHMARK(BM_Move)->Apply(Inputs);
+BENCHMARK(BM_EraseInsert)->Apply(Inputs);
+BENCHMARK(BM_Churn)->Apply(Policies);
+BENCHMARK(BM_SplitPolicy)->Apply(Splits)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Frame)->Apply(Inputs)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
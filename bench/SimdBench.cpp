@@ -0,0 +1,107 @@
+#include "QuadTree.h"
+#include "Simd.h"
+#include "Points.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+namespace {
+
+	using bench::SIDE;
+
+	std::vector<mt::Pt> GenerateUniform(size_t count, uint32_t seed) {
+		return bench::GeneratePoints(bench::Distribution::UNIFORM, count, seed);
+	}
+
+	// the first argument is tree::simd::Level
+	template<size_t LeafCapacity>
+	void BM_RectQuery(benchmark::State& state) {
+		const auto level = static_cast<tree::simd::Level>(state.range(0));
+		if (level > tree::simd::GetSupportedLevel()) {
+			state.SkipWithError("Instruction set is not supported");
+			return;
+		}
+		tree::simd::SetLevel(level);
+
+		tree::QuadTree<tree::NoPayload, float, LeafCapacity> tree{ { { 0.f, 0.f }, { SIDE, SIDE } } };
+		tree.Build(GenerateUniform(1 << 20, 1));
+		const auto areas = bench::GenerateAreas(1024, 32.f, 2);
+
+		size_t found{ 0 };
+		size_t query{ 0 };
+		for (auto _ : state) {
+			tree.ForEachAt(areas[query++ % areas.size()], [&found](const mt::Pt&, const tree::NoPayload&, tree::Handle) {
+				found++;
+			});
+		}
+		benchmark::DoNotOptimize(found);
+		state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+		tree::simd::SetLevel(tree::simd::GetSupportedLevel());
+	}
+
+	template<size_t LeafCapacity>
+	void BM_RadiusQuery(benchmark::State& state) {
+		const auto level = static_cast<tree::simd::Level>(state.range(0));
+		if (level > tree::simd::GetSupportedLevel()) {
+			state.SkipWithError("Instruction set is not supported");
+			return;
+		}
+		tree::simd::SetLevel(level);
+
+		tree::QuadTree<tree::NoPayload, float, LeafCapacity> tree{ { { 0.f, 0.f }, { SIDE, SIDE } } };
+		tree.Build(GenerateUniform(1 << 20, 1));
+		const auto centers = GenerateUniform(1024, 3);
+
+		size_t query{ 0 };
+		for (auto _ : state) {
+			benchmark::DoNotOptimize(tree.FindWithinRadius(centers[query++ % centers.size()], 16.f));
+		}
+		state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+		tree::simd::SetLevel(tree::simd::GetSupportedLevel());
+	}
+
+	// the leaf kernel alone: scan a block of points
+	void BM_FindInRect(benchmark::State& state) {
+		const auto level = static_cast<tree::simd::Level>(state.range(0));
+		if (level > tree::simd::GetSupportedLevel()) {
+			state.SkipWithError("Instruction set is not supported");
+			return;
+		}
+		tree::simd::SetLevel(level);
+
+		const auto count = static_cast<size_t>(state.range(1));
+		const auto points = GenerateUniform(count, 4);
+		std::vector<float> xs, ys;
+		for (const auto& point : points) {
+			xs.push_back(point.x);
+			ys.push_back(point.y);
+		}
+		std::vector<uint32_t> indices(count);
+		const mt::Rect area{ { 256.f, 256.f }, { 512.f, 512.f } };
+
+		for (auto _ : state) {
+			benchmark::DoNotOptimize(tree::simd::FindInRect(xs.data(), ys.data(), count, area, indices.data()));
+			benchmark::ClobberMemory();
+		}
+		state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+		tree::simd::SetLevel(tree::simd::GetSupportedLevel());
+	}
+
+	void Levels(benchmark::internal::Benchmark* benchmark) {
+		benchmark->ArgName("level");
+		for (auto level : { tree::simd::Level::SCALAR, tree::simd::Level::SSE, tree::simd::Level::AVX2 }) {
+			benchmark->Arg(static_cast<int64_t>(level));
+		}
+	}
+
+} // namespace {
+
+BENCHMARK_TEMPLATE(BM_RectQuery, 8)->Apply(Levels);
+BENCHMARK_TEMPLATE(BM_RectQuery, 32)->Apply(Levels);
+BENCHMARK_TEMPLATE(BM_RectQuery, 128)->Apply(Levels);
+BENCHMARK_TEMPLATE(BM_RadiusQuery, 32)->Apply(Levels);
+BENCHMARK_TEMPLATE(BM_RadiusQuery, 128)->Apply(Levels);
+BENCHMARK(BM_FindInRect)->ArgNames({ "level", "points" })->ArgsProduct({ { 0, 1, 2 }, { 16, 128, 1024 } });
+
+BENCHMARK_MAIN();
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "healthy.h"
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
+// common statistics of the points for `QuadTree` (see NoAggregate)
+namespace tree {
+
+	// number of points
+	struct CountAggregate {
+		using Value = size_t;
+
+		template<class Point, class Payload>
+		static constexpr Value Make(const Point&, const Payload&) noexcept {
+			return 1;
+		}
+
+		static constexpr Value Combine(Value lhs, Value rhs) noexcept {
+			return lhs + rhs;
+		}
+	};
+
+	// sum of the payloads, `T` is constructible from the payload
+	template<class T>
+	struct SumAggregate {
+		using Value = T;
+
+		template<class Point, class Payload>
+		static constexpr Value Make(const Point&, const Payload& payload) {
+			return static_cast<T>(payload);
+		}
+
+		static constexpr Value Combine(const Value& lhs, const Value& rhs) {
+			return lhs + rhs;
+		}
+	};
+
+	// the smallest box containing the points
+	template<class Coord>
+	struct BoundsAggregate {
+		struct Value {
+			// empty when no points are combined: `left > right`
+			Coord left{ std::numeric_limits<Coord>::max() };
+			Coord top{ std::numeric_limits<Coord>::max() };
+			Coord right{ std::numeric_limits<Coord>::lowest() };
+			Coord bottom{ std::numeric_limits<Coord>::lowest() };
+
+			constexpr bool IsEmpty() const noexcept {
+				return left > right;
+			}
+		};
+
+		template<class Point, class Payload>
+		static constexpr Value Make(const Point& point, const Payload&) noexcept {
+			return { point.x, point.y, point.x, point.y };
+		}
+
+		static constexpr Value Combine(const Value& lhs, const Value& rhs) noexcept {
+			return {
+				std::min(lhs.left, rhs.left), std::min(lhs.top, rhs.top),
+				std::max(lhs.right, rhs.right), std::max(lhs.bottom, rhs.bottom)
+			};
+		}
+	};
+
+	// mean position of the points
+	template<class Coord>
+	struct CentroidAggregate {
+		struct Value {
+			// sums are kept in double: the float ones lose precision on large subtrees
+			double x{ 0.0 };
+			double y{ 0.0 };
+			size_t count{ 0 };
+
+			// return the centroid, the points should be present
+			mt::BasicPt<Coord> GetCentroid() const noexcept {
+				return { static_cast<Coord>(x / count), static_cast<Coord>(y / count) };
+			}
+		};
+
+		template<class Point, class Payload>
+		static constexpr Value Make(const Point& point, const Payload&) noexcept {
+			return { static_cast<double>(point.x), static_cast<double>(point.y), 1 };
+		}
+
+		static constexpr Value Combine(const Value& lhs, const Value& rhs) noexcept {
+			return { lhs.x + rhs.x, lhs.y + rhs.y, lhs.count + rhs.count };
+		}
+	};
+
+} // namespace tree
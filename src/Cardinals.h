@@ -0,0 +1,215 @@
+#pragma once
+
+#include "healthy.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+
+namespace tree {
+
+	/**
+	 * NE - corresponds to top-right quarter
+	 * SE - corresponds to bottom-right quarter
+	 * NW - corresponds to top-left quarter
+	 * SW - corresponds to bottom-left quarter
+	 */
+	enum Cardinals { NW = 0, NE, SW, SE, COUNT };
+
+	// side of the box shared with its face neighbour
+	enum class Side { NORTH, SOUTH, WEST, EAST };
+
+	/**
+	 * How the box of a node is divided into the quarters of its children.
+	 */
+	enum class Division : uint8_t {
+		// at the middle of the box (see GetQuarter and GetRect)
+		MIDDLE,
+		// at the center point chosen by the node (e.g. the median of its points)
+		CENTER,
+		// not divided: the node is an overflow leaf, all of the box belongs to NW child which has the same box
+		NONE
+	};
+
+	/**
+	 * Get quarter base where the point belongs base on following SFML coordinate system:
+	 * (0, 0) ----------- (W, 0)
+	 * ...
+	 * ...
+	 * (0, H) ----------- (W, H)
+	 */
+	template<class Coord>
+	constexpr Cardinals GetQuarter(const mt::BasicPt<Coord>& point, const mt::BasicRect<Coord>& box) noexcept {
+		Cardinals cardinal = Cardinals::NE;
+		if (point.x >= box.GetMidX()) { // EAST
+			cardinal = point.y >= box.GetMidY() ? Cardinals::SE : Cardinals::NE;
+		}
+		else { // WEST
+			cardinal = point.y >= box.GetMidY() ? Cardinals::SW : Cardinals::NW;
+		}
+		return cardinal;
+	}
+
+	// get quarter of the box divided at the center where the point belongs
+	template<class Coord>
+	constexpr Cardinals GetQuarter(const mt::BasicPt<Coord>& point, const mt::BasicPt<Coord>& center) noexcept {
+		if (point.x >= center.x) { // EAST
+			return point.y >= center.y ? Cardinals::SE : Cardinals::NE;
+		}
+		return point.y >= center.y ? Cardinals::SW : Cardinals::NW;
+	}
+
+	// get quarter of the box divided as described by the division where the point belongs
+	template<class Coord>
+	constexpr Cardinals GetQuarter(
+		const mt::BasicPt<Coord>& point, const mt::BasicRect<Coord>& box, Division division, const mt::BasicPt<Coord>& center
+	) noexcept {
+		switch (division) {
+		case Division::CENTER: return GetQuarter(point, center);
+		case Division::NONE: return Cardinals::NW;
+		default: return GetQuarter(point, box);
+		}
+	}
+
+	/**
+	 * Form rectangle from quarter on following SFML coordinate system:
+	 * (0, 0) ----------- (W, 0)
+	 * ...
+	 * ...
+	 * (0, H) ----------- (W, H)
+	 * @note the eastern and southern quarters take the remainder of odd integer sizes
+	 */
+	template<class Coord>
+	constexpr mt::BasicRect<Coord> GetRect(Cardinals cardinal, const mt::BasicRect<Coord>& box) noexcept {
+		const Coord west = box.size.width / Coord(2);
+		const Coord north = box.size.height / Coord(2);
+		const Coord east = box.size.width - west;
+		const Coord south = box.size.height - north;
+
+		switch (cardinal) {
+		case Cardinals::NE:
+			return { box.GetMidX(), box.GetMinY(), east, north };
+		case Cardinals::SE:
+			return { box.GetMidX(), box.GetMidY(), east, south };
+		case Cardinals::NW:
+			return { box.GetMinX(), box.GetMinY(), west, north };
+		case Cardinals::SW:
+			return { box.GetMinX(), box.GetMidY(), west, south };
+		default: assert(false && "Can't fallthrough here!");  break;
+		}
+
+		return box;
+	}
+
+	// form rectangle from quarter of the box divided at the center, the center should be inside the box
+	template<class Coord>
+	constexpr mt::BasicRect<Coord> GetRect(
+		Cardinals cardinal, const mt::BasicRect<Coord>& box, const mt::BasicPt<Coord>& center
+	) noexcept {
+		const Coord west = center.x - box.GetMinX();
+		const Coord north = center.y - box.GetMinY();
+		const Coord east = box.GetMaxX() - center.x;
+		const Coord south = box.GetMaxY() - center.y;
+
+		switch (cardinal) {
+		case Cardinals::NE:
+			return { center.x, box.GetMinY(), east, north };
+		case Cardinals::SE:
+			return { center.x, center.y, east, south };
+		case Cardinals::NW:
+			return { box.GetMinX(), box.GetMinY(), west, north };
+		case Cardinals::SW:
+			return { box.GetMinX(), center.y, west, south };
+		default: assert(false && "Can't fallthrough here!");  break;
+		}
+
+		return box;
+	}
+
+	// form rectangle from quarter of the box divided as described by the division
+	template<class Coord>
+	constexpr mt::BasicRect<Coord> GetRect(
+		Cardinals cardinal, const mt::BasicRect<Coord>& box, Division division, const mt::BasicPt<Coord>& center
+	) noexcept {
+		switch (division) {
+		case Division::CENTER: return GetRect(cardinal, box, center);
+		case Division::NONE: return box;
+		default: return GetRect(cardinal, box);
+		}
+	}
+
+	/**
+	 * Type of squared distances between points with the coordinates of the type.
+	 * Squares of the differences of integer coordinates overflow the type (and the differences
+	 * of unsigned ones wrap), so they are computed in double.
+	 */
+	template<class Coord>
+	using SquareDistance_t = std::conditional_t<std::is_floating_point_v<Coord>, Coord, double>;
+
+	template<class Coord>
+	constexpr SquareDistance_t<Coord> GetSquareDistance(const mt::BasicPt<Coord>& lhs, const mt::BasicPt<Coord>& rhs) noexcept {
+		using Distance = SquareDistance_t<Coord>;
+		const Distance dx = static_cast<Distance>(lhs.x) - static_cast<Distance>(rhs.x);
+		const Distance dy = static_cast<Distance>(lhs.y) - static_cast<Distance>(rhs.y);
+		return dx * dx + dy * dy;
+	}
+
+	// return squared distance from the point to the closest point of the box
+	template<class Coord>
+	constexpr SquareDistance_t<Coord> GetSquareDistance(const mt::BasicRect<Coord>& box, const mt::BasicPt<Coord>& point) noexcept {
+		using Distance = SquareDistance_t<Coord>;
+		const auto axis = [](Coord low, Coord high, Coord value) {
+			if (value < low) {
+				return static_cast<Distance>(low) - static_cast<Distance>(value);
+			}
+			return value > high ? static_cast<Distance>(value) - static_cast<Distance>(high) : Distance(0);
+		};
+		const Distance dx = axis(box.GetMinX(), box.GetMaxX(), point.x);
+		const Distance dy = axis(box.GetMinY(), box.GetMaxY(), point.y);
+		return dx * dx + dy * dy;
+	}
+
+	// return squared distance from the point to the farthest corner of the box
+	template<class Coord>
+	constexpr SquareDistance_t<Coord> GetFarthestSquareDistance(const mt::BasicRect<Coord>& box, const mt::BasicPt<Coord>& point) noexcept {
+		using Distance = SquareDistance_t<Coord>;
+		const auto axis = [](Coord low, Coord high, Coord value) {
+			const Distance toLow = static_cast<Distance>(value) - static_cast<Distance>(low);
+			const Distance toHigh = static_cast<Distance>(high) - static_cast<Distance>(value);
+			return std::max(toLow < Distance(0) ? -toLow : toLow, toHigh < Distance(0) ? -toHigh : toHigh);
+		};
+		const Distance dx = axis(box.GetMinX(), box.GetMaxX(), point.x);
+		const Distance dy = axis(box.GetMinY(), box.GetMaxY(), point.y);
+		return dx * dx + dy * dy;
+	}
+
+	/**
+	 * Whether the quarters of the division cover the whole box: rounding of the boundaries
+	 * of the quarters may leave gaps between them or at the edges of the box where points are lost.
+	 */
+	template<class Coord>
+	constexpr bool IsCovered(
+		const mt::BasicRect<Coord>& box, Division division, const mt::BasicPt<Coord>& center
+	) noexcept {
+		const auto northWest = GetRect(Cardinals::NW, box, division, center);
+		const auto southEast = GetRect(Cardinals::SE, box, division, center);
+		// the other quarters share the boundaries of these ones
+		return northWest.GetMaxX() >= southEast.GetMinX() && northWest.GetMaxY() >= southEast.GetMinY()
+			&& southEast.GetMaxX() >= box.GetMaxX() && southEast.GetMaxY() >= box.GetMaxY();
+	}
+
+	/**
+	 * Whether the middle of the box divides it into quarters which sides are at least `minSize`.
+	 * The box which middle is rounded to its edge or which quarters don't cover it (see IsCovered)
+	 * isn't divisible, e.g. tiny box of floats far from the origin.
+	 */
+	template<class Coord>
+	constexpr bool IsDivisible(const mt::BasicRect<Coord>& box, Coord minSize) noexcept {
+		return box.size.width / Coord(2) >= minSize
+			&& box.size.height / Coord(2) >= minSize
+			&& box.GetMinX() < box.GetMidX() && box.GetMidX() < box.GetMaxX()
+			&& box.GetMinY() < box.GetMidY() && box.GetMidY() < box.GetMaxY()
+			&& IsCovered(box, Division::MIDDLE, box.GetMid());
+	}
+
+} // namespace tree
@@ -0,0 +1,435 @@
+#pragma once
+
+#include "QuadTree.h"
+#include "NodePool.h"
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <iterator>
+#include <cassert>
+#include <type_traits>
+#include <utility>
+
+namespace tree {
+
+	// lock of a node: it's held for a few comparisons only, so waiting threads spin
+	class SpinLock {
+	public:
+		void lock() noexcept {
+			size_t spins{ 0 };
+			while (m_locked.exchange(true, std::memory_order_acquire)) {
+				// wait without writing to the cache line
+				while (m_locked.load(std::memory_order_relaxed)) {
+					if (++spins % SPINS_BEFORE_YIELD == 0) {
+						std::this_thread::yield();
+					}
+				}
+			}
+		}
+
+		void unlock() noexcept {
+			m_locked.store(false, std::memory_order_release);
+		}
+
+	private:
+		static constexpr size_t SPINS_BEFORE_YIELD{ 64 };
+
+		std::atomic<bool> m_locked{ false };
+	};
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	struct ConcurrentNode {
+		using pointer = ConcurrentNode*;
+		using Point = mt::BasicPt<Coord>;
+		using Rect = mt::BasicRect<Coord>;
+
+		static constexpr size_t MAX_POINTS{ LeafCapacity };
+
+		// a child is published once and never changes
+		std::array<std::atomic<pointer>, Cardinals::COUNT> m_children{};
+		// guards the points of the node and publication of the children
+		mutable SpinLock m_lock;
+		std::array<Coord, MAX_POINTS> m_xs;
+		std::array<Coord, MAX_POINTS> m_ys;
+		std::array<Payload, MAX_POINTS> m_values;
+		uint32_t m_size{ 0 };
+		Rect m_box{ {0, 0}, {0, 0} };
+		// Division::MIDDLE or Division::NONE for the overflow leaf, it's set before the first child is published
+		std::atomic<Division> m_division{ Division::MIDDLE };
+
+		// return the quarter of the box where the point belongs
+		Cardinals GetQuarter(const Point& point) const noexcept;
+
+		/**
+		 * Whether the overflow leaf keeps the point itself, it's called once its child is loaded:
+		 * the full overflow leaf doesn't change its points anymore.
+		 */
+		bool KeepsOverflow(const Point& point) const noexcept;
+
+		// return index of the point or `m_size` if the node doesn't have it
+		size_t Find(const Point& point) const noexcept;
+
+		void Push(const Point& point, Payload value);
+
+		// remove the point replacing it with the last one
+		void Remove(size_t index);
+	};
+
+	/**
+	 * Quad tree which points are inserted by many threads at the same time.
+	 *
+	 * The descent goes through published children without locks, only the node which receives
+	 * the point is locked. A full node is split under its lock: the points of the quarter are
+	 * moved to the new child before the child is published, so a point is always found either
+	 * in the node (the quarter has no child) or in the child.
+	 * Like in QuadTree the node at the maximum depth or with too small box becomes an overflow leaf:
+	 * it keeps its points and passes the rest to its only child with the same box.
+	 * Queries lock the nodes one at a time and may run along with insertions.
+	 *
+	 * The tree is meant for ingestion: points aren't erased.
+	 *
+	 * @tparam Payload the value stored with each point
+	 * @tparam Coord the type of coordinates, any arithmetic type
+	 * @tparam LeafCapacity maximum number of points kept by a node
+	 */
+	template<class Payload = NoPayload, class Coord = float, size_t LeafCapacity = DEFAULT_LEAF_CAPACITY>
+	class ConcurrentQuadTree {
+		static_assert(std::is_arithmetic_v<Coord>, "Coordinates must be of arithmetic type");
+		static_assert(LeafCapacity > 0, "Node must be able to keep at least one point");
+
+	public:
+		using Node = ConcurrentNode<Payload, Coord, LeafCapacity>;
+		using Point = typename Node::Point;
+		using Rect = typename Node::Rect;
+
+		static constexpr size_t MAX_POINTS{ LeafCapacity };
+
+		explicit ConcurrentQuadTree(const Rect& fullArea, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+		~ConcurrentQuadTree();
+
+		ConcurrentQuadTree(const ConcurrentQuadTree&) = delete;
+		ConcurrentQuadTree& operator=(const ConcurrentQuadTree&) = delete;
+
+		/**
+		 * Insert the point with the value unless the point is already in the tree.
+		 * Return whether the point was inserted. It's safe to call from any thread.
+		 */
+		bool Insert(const Point& point, Payload value = {});
+
+		bool Contains(const Point& point) const;
+
+		// return all of points in the area
+		std::vector<Point> GetPointsAt(const Rect& area) const;
+
+		// write all of points in the area to `out` and return the end of the output
+		template<class OutputIt>
+		OutputIt GetPointsAt(const Rect& area, OutputIt out) const;
+
+		/**
+		 * Call `visitor(point, value)` for each point in the area.
+		 * The visitor is called without any lock held, with copies of the point and value.
+		 * The visitor may return false to stop the traversal early.
+		 * Return false if the traversal was stopped by the visitor.
+		 */
+		template<class Visitor>
+		bool ForEachAt(const Rect& area, Visitor&& visitor) const;
+
+		// return number of points in the tree
+		size_t GetSize() const noexcept;
+
+		bool IsEmpty() const noexcept;
+
+		// set the depth of the nodes which aren't divided anymore (see QuadTree::SetSplitPolicy), not along with `Insert`
+		void SetMaxDepth(size_t maxDepth) noexcept;
+
+		// set the minimum size of the quarters (see QuadTree::SetMinCellSize), not along with `Insert`
+		void SetMinCellSize(Coord size) noexcept;
+
+	private:
+		/**
+		 * Return the new child of the full node at the depth for the quarter of the point.
+		 * The leaf chooses its division first, the child takes the points of its quarter.
+		 */
+		Node* Split(Node* node, const Point& point, size_t depth);
+
+		void Release(Node* node);
+
+	private:
+		Node* m_root{ nullptr };
+		std::atomic<size_t> m_size{ 0 };
+		size_t m_maxDepth{ DEFAULT_MAX_DEPTH };
+		Coord m_minCellSize{ 0 };
+		// splits take nodes under the lock: they are rare comparing to insertions
+		std::mutex m_poolMutex;
+		NodePool<Node> m_pool;
+	};
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	Cardinals ConcurrentNode<Payload, Coord, LeafCapacity>::GetQuarter(const Point& point) const noexcept {
+		return m_division.load(std::memory_order_acquire) == Division::NONE ? Cardinals::NW : tree::GetQuarter(point, m_box);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool ConcurrentNode<Payload, Coord, LeafCapacity>::KeepsOverflow(const Point& point) const noexcept {
+		return m_division.load(std::memory_order_acquire) == Division::NONE && Find(point) < m_size;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	size_t ConcurrentNode<Payload, Coord, LeafCapacity>::Find(const Point& point) const noexcept {
+		size_t index{ 0 };
+		while (index < m_size && !(m_xs[index] == point.x && m_ys[index] == point.y)) {
+			index++;
+		}
+		return index;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void ConcurrentNode<Payload, Coord, LeafCapacity>::Push(const Point& point, Payload value) {
+		assert(m_size < MAX_POINTS && "Node is full");
+		m_xs[m_size] = point.x;
+		m_ys[m_size] = point.y;
+		m_values[m_size] = std::move(value);
+		m_size++;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void ConcurrentNode<Payload, Coord, LeafCapacity>::Remove(size_t index) {
+		assert(index < m_size && "Index is out of range");
+		const size_t last = m_size - 1;
+		if (index != last) {
+			m_xs[index] = m_xs[last];
+			m_ys[index] = m_ys[last];
+			m_values[index] = std::move(m_values[last]);
+		}
+		// release resources of the value
+		m_values[last] = Payload{};
+		m_size--;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	ConcurrentQuadTree<Payload, Coord, LeafCapacity>::ConcurrentQuadTree(
+		const Rect& fullArea, std::pmr::memory_resource* resource
+	)
+		: m_pool{ resource }
+	{
+		m_root = m_pool.Acquire();
+		m_root->m_box = fullArea;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	ConcurrentQuadTree<Payload, Coord, LeafCapacity>::~ConcurrentQuadTree() {
+		// memory is freed by the pool
+		if constexpr (!std::is_trivially_destructible_v<Node>) {
+			Release(m_root);
+		}
+	}
+
+	/**
+	 * The same descent as QuadTree::Insert, the node is locked only to change its points.
+	 * The quarter is chosen again under the lock: the node may have chosen its division meanwhile.
+	 * The division is loaded again after the child (see KeepsOverflow), so the overflow leaf isn't passed by.
+	 */
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool ConcurrentQuadTree<Payload, Coord, LeafCapacity>::Insert(const Point& point, Payload value) {
+		for (auto [node, depth] = std::pair<Node*, size_t>{ m_root, 0 }; ; depth++) {
+			// point is outside the boundary
+			if (!node->m_box.Contains(point)) {
+				return false;
+			}
+
+			// find a needed quarter
+			if (const auto child = node->m_children[node->GetQuarter(point)].load(std::memory_order_acquire); child != nullptr) {
+				if (node->KeepsOverflow(point)) { // point already exist in the tree
+					return false;
+				}
+				node = child;
+				continue;
+			}
+
+			std::lock_guard<SpinLock> lock{ node->m_lock };
+			if (const auto child = node->m_children[node->GetQuarter(point)].load(std::memory_order_relaxed); child != nullptr) {
+				// the quarter was split while the lock was awaited
+				if (node->KeepsOverflow(point)) {
+					return false;
+				}
+				node = child;
+			}
+			else if (node->Find(point) < node->m_size) { // point already exist in the tree
+				return false;
+			}
+			else if (node->m_size < MAX_POINTS) { // see if the node still can accomodate any point
+				node->Push(point, std::move(value));
+				m_size.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+			else {
+				node = Split(node, point, depth);
+			}
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto ConcurrentQuadTree<Payload, Coord, LeafCapacity>::Split(Node* node, const Point& point, size_t depth) -> Node* {
+		const bool isLeaf = std::all_of(node->m_children.cbegin(), node->m_children.cend(), [](const auto& child) {
+			return child.load(std::memory_order_relaxed) == nullptr;
+		});
+		if (isLeaf) {
+			// the same rule as QuadTree::Divide for the midpoint split, it's published with the child
+			const bool divisible = depth < m_maxDepth && IsDivisible(node->m_box, m_minCellSize);
+			node->m_division.store(divisible ? Division::MIDDLE : Division::NONE, std::memory_order_relaxed);
+		}
+		const auto division = node->m_division.load(std::memory_order_relaxed);
+		const auto cardinal = node->GetQuarter(point);
+
+		Node* child{ nullptr };
+		{
+			std::lock_guard<std::mutex> lock{ m_poolMutex };
+			child = m_pool.Acquire();
+		}
+		child->m_box = division == Division::NONE ? node->m_box : GetRect(cardinal, node->m_box);
+
+		// move points which have same quarter to this child node, the overflow leaf keeps its points
+		for (size_t i = 0; division != Division::NONE && i < node->m_size; ) {
+			if (const Point moved{ node->m_xs[i], node->m_ys[i] }; child->m_box.Contains(moved)) {
+				child->Push(moved, std::move(node->m_values[i]));
+				node->Remove(i);
+			}
+			else {
+				i++;
+			}
+		}
+		// the child is visible with all of its points
+		node->m_children[cardinal].store(child, std::memory_order_release);
+		return child;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool ConcurrentQuadTree<Payload, Coord, LeafCapacity>::Contains(const Point& point) const {
+		for (const Node* node = m_root; ; ) {
+			// point is outside the boundary
+			if (!node->m_box.Contains(point)) {
+				return false;
+			}
+
+			if (const auto child = node->m_children[node->GetQuarter(point)].load(std::memory_order_acquire); child != nullptr) {
+				if (node->KeepsOverflow(point)) {
+					return true;
+				}
+				node = child;
+				continue;
+			}
+
+			std::lock_guard<SpinLock> lock{ node->m_lock };
+			// points of the quarter are in the node while it has no child
+			if (node->m_children[node->GetQuarter(point)].load(std::memory_order_relaxed) == nullptr) {
+				return node->Find(point) < node->m_size;
+			}
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto ConcurrentQuadTree<Payload, Coord, LeafCapacity>::GetPointsAt(const Rect& area) const -> std::vector<Point> {
+		std::vector<Point> points;
+		GetPointsAt(area, std::back_inserter(points));
+		return points;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	template<class OutputIt>
+	OutputIt ConcurrentQuadTree<Payload, Coord, LeafCapacity>::GetPointsAt(const Rect& area, OutputIt out) const {
+		ForEachAt(area, [&out](const Point& point, const Payload&) {
+			*out++ = point;
+		});
+		return out;
+	}
+
+	/**
+	 * The points and the children of a node are read under its lock at once,
+	 * so the points moved to the child published later were read from the node.
+	 */
+	template<class Payload, class Coord, size_t LeafCapacity>
+	template<class Visitor>
+	bool ConcurrentQuadTree<Payload, Coord, LeafCapacity>::ForEachAt(const Rect& area, Visitor&& visitor) const {
+		InlineStack<const Node*, QuadTree<Payload, Coord, LeafCapacity>::INLINE_STACK_SIZE> processed;
+		processed.Push(m_root);
+		std::array<uint32_t, MAX_POINTS> found;
+		std::array<Point, MAX_POINTS> points;
+		std::array<Payload, MAX_POINTS> values;
+		std::array<const Node*, Cardinals::COUNT> children;
+		Division division{ Division::MIDDLE };
+
+		while (!processed.IsEmpty()) {
+			const auto current = processed.Pop();
+
+			size_t count{ 0 };
+			{
+				std::lock_guard<SpinLock> lock{ current->m_lock };
+				count = simd::FindInRect(current->m_xs.data(), current->m_ys.data(), current->m_size, area, found.data());
+				for (size_t k = 0; k < count; k++) {
+					points[k] = { current->m_xs[found[k]], current->m_ys[found[k]] };
+					values[k] = current->m_values[found[k]];
+				}
+				for (size_t i = 0; i < Cardinals::COUNT; i++) {
+					children[i] = current->m_children[i].load(std::memory_order_acquire);
+				}
+				division = current->m_division.load(std::memory_order_relaxed);
+			}
+
+			for (size_t k = 0; k < count; k++) {
+				if (!detail::Visit(visitor, points[k], values[k])) {
+					return false;
+				}
+			}
+
+			// the center isn't used by these divisions
+			const unsigned quarters = simd::IntersectQuarters(current->m_box, division, current->m_box.GetMid(), area);
+			for (size_t i = 0; i < Cardinals::COUNT; i++) {
+				if (children[i] && (quarters & (1u << i))) {
+					processed.Push(children[i]);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	size_t ConcurrentQuadTree<Payload, Coord, LeafCapacity>::GetSize() const noexcept {
+		return m_size.load(std::memory_order_relaxed);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool ConcurrentQuadTree<Payload, Coord, LeafCapacity>::IsEmpty() const noexcept {
+		return GetSize() == 0;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void ConcurrentQuadTree<Payload, Coord, LeafCapacity>::SetMaxDepth(size_t maxDepth) noexcept {
+		m_maxDepth = maxDepth;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void ConcurrentQuadTree<Payload, Coord, LeafCapacity>::SetMinCellSize(Coord size) noexcept {
+		m_minCellSize = size;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void ConcurrentQuadTree<Payload, Coord, LeafCapacity>::Release(Node* node) {
+		InlineStack<Node*, QuadTree<Payload, Coord, LeafCapacity>::INLINE_STACK_SIZE> pending;
+		pending.Push(node);
+		while (!pending.IsEmpty()) {
+			const auto current = pending.Pop();
+			for (auto& child : current->m_children) {
+				if (const auto pointer = child.load(std::memory_order_relaxed); pointer != nullptr) {
+					pending.Push(pointer);
+				}
+			}
+			m_pool.Release(current);
+		}
+	}
+
+} // namespace tree
@@ -0,0 +1,274 @@
+#include "FlatQuadTree.h"
+
+#include <utility>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace tree::detail {
+
+	bool IsLittleEndian() noexcept {
+		const uint32_t value{ 1 };
+		unsigned char first;
+		std::memcpy(&first, &value, 1);
+		return first == 1;
+	}
+
+	FlatHeader MakeFlatHeader(
+		uint32_t coordType, uint32_t payloadSize, uint32_t nodeSize, uint64_t nodeCount, uint64_t pointCount
+	) noexcept {
+		const uint64_t coordSize = coordType & ~FLAT_FLOATING;
+		FlatHeader header{};
+		header.magic = FLAT_MAGIC;
+		header.version = FLAT_VERSION;
+		header.coordType = coordType;
+		header.payloadSize = payloadSize;
+		header.nodeSize = nodeSize;
+		header.nodeCount = nodeCount;
+		header.pointCount = pointCount;
+		header.nodes = FLAT_HEADER_SIZE;
+		header.xs = header.nodes + GetFlatSectionSize(nodeCount * nodeSize);
+		header.ys = header.xs + GetFlatSectionSize(pointCount * coordSize);
+		header.values = header.ys + GetFlatSectionSize(pointCount * coordSize);
+		header.fileSize = header.values + GetFlatSectionSize(pointCount * payloadSize);
+		return header;
+	}
+
+	uint64_t Checksum::Mix(uint64_t hash, uint64_t word) noexcept {
+		hash = (hash ^ word) * 0x100000001b3ull;
+		// the product moves changes of the low bits up only: bring the high bits down
+		return hash ^ (hash >> 32);
+	}
+
+	void Checksum::Update(const void* data, size_t size) noexcept {
+		auto bytes = static_cast<const unsigned char*>(data);
+		// complete the pending word first
+		while (size > 0 && m_pendingSize > 0) {
+			m_pending[m_pendingSize++] = *bytes++;
+			size--;
+			if (m_pendingSize == m_pending.size()) {
+				uint64_t word;
+				std::memcpy(&word, m_pending.data(), sizeof(word));
+				m_hash = Mix(m_hash, word);
+				m_pendingSize = 0;
+			}
+		}
+		for (; size >= sizeof(uint64_t); bytes += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+			uint64_t word;
+			std::memcpy(&word, bytes, sizeof(word));
+			m_hash = Mix(m_hash, word);
+		}
+		for (; size > 0; size--) {
+			m_pending[m_pendingSize++] = *bytes++;
+		}
+	}
+
+	uint64_t Checksum::GetValue() const noexcept {
+		if (m_pendingSize == 0) {
+			return m_hash;
+		}
+		std::array<unsigned char, 8> last{};
+		std::memcpy(last.data(), m_pending.data(), m_pendingSize);
+		uint64_t word;
+		std::memcpy(&word, last.data(), sizeof(word));
+		return Mix(m_hash, word);
+	}
+
+	FlatStatus CheckFlatFile(
+		const std::byte* data, size_t size,
+		uint32_t coordType, uint32_t payloadSize, uint32_t nodeSize, bool verifyChecksum
+	) noexcept {
+		if (size < FLAT_HEADER_SIZE) {
+			return FlatStatus::BAD_FORMAT;
+		}
+		FlatHeader header;
+		std::memcpy(&header, data, sizeof(header));
+		if (header.magic != FLAT_MAGIC) {
+			return FlatStatus::BAD_FORMAT;
+		}
+		if (header.version != FLAT_VERSION) {
+			return FlatStatus::BAD_VERSION;
+		}
+		if (header.coordType != coordType || header.payloadSize != payloadSize || header.nodeSize != nodeSize) {
+			return FlatStatus::TYPE_MISMATCH;
+		}
+
+		// each section is at its place and the whole file is present
+		const auto coordSize = coordType & ~FLAT_FLOATING;
+		if (header.fileSize != size
+			|| header.nodeCount == 0
+			|| header.pointCount > std::numeric_limits<uint32_t>::max()
+			|| header.nodeCount > size / nodeSize
+			|| header.nodes != FLAT_HEADER_SIZE
+			|| header.xs != header.nodes + GetFlatSectionSize(header.nodeCount * nodeSize)
+			|| header.xs > size
+			|| header.pointCount > (size - header.xs) / coordSize
+			|| header.ys != header.xs + GetFlatSectionSize(header.pointCount * coordSize)
+			|| header.values != header.ys + GetFlatSectionSize(header.pointCount * coordSize)
+			|| header.fileSize != header.values + GetFlatSectionSize(header.pointCount * payloadSize)
+		) {
+			return FlatStatus::BAD_FORMAT;
+		}
+
+		if (verifyChecksum) {
+			Checksum checksum;
+			checksum.Update(data + FLAT_HEADER_SIZE, size - FLAT_HEADER_SIZE);
+			if (checksum.GetValue() != header.checksum) {
+				return FlatStatus::BAD_CHECKSUM;
+			}
+		}
+		return FlatStatus::OK;
+	}
+
+	void WriteFlatSection(std::ostream& out, const void* data, size_t size, Checksum& checksum) {
+		static const std::array<char, FLAT_ALIGNMENT> zeros{};
+		const size_t padding = GetFlatSectionSize(size) - size;
+		out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		out.write(zeros.data(), static_cast<std::streamsize>(padding));
+		checksum.Update(data, size);
+		checksum.Update(zeros.data(), padding);
+	}
+
+	MappedFile::~MappedFile() {
+		Close();
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept {
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+		if (this != &other) {
+			Close();
+			m_data = std::exchange(other.m_data, nullptr);
+			m_size = std::exchange(other.m_size, 0);
+			m_writable = std::exchange(other.m_writable, false);
+		#ifdef _WIN32
+			m_file = std::exchange(other.m_file, nullptr);
+			m_mapping = std::exchange(other.m_mapping, nullptr);
+		#endif
+		}
+		return *this;
+	}
+
+#ifdef _WIN32
+
+	bool MappedFile::Open(const std::string& path, bool writable) {
+		Close();
+		const HANDLE file = CreateFileA(
+			path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ,
+			nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+		);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
+		const HANDLE mapping = CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) {
+			CloseHandle(file);
+			return false;
+		}
+		void* data = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+		if (!data) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		m_file = file;
+		m_mapping = mapping;
+		m_data = static_cast<std::byte*>(data);
+		m_size = static_cast<size_t>(size.QuadPart);
+		m_writable = writable;
+		return true;
+	}
+
+	bool MappedFile::Create(const std::string& path, size_t size) {
+		Close();
+		const HANDLE file = CreateFileA(
+			path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr
+		);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER end;
+		end.QuadPart = static_cast<LONGLONG>(size);
+		const bool resized = SetFilePointerEx(file, end, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+		CloseHandle(file);
+		return resized && Open(path, true);
+	}
+
+	void MappedFile::Close() noexcept {
+		if (m_data) {
+			UnmapViewOfFile(m_data);
+			CloseHandle(m_mapping);
+			CloseHandle(m_file);
+		}
+		m_data = nullptr;
+		m_size = 0;
+		m_writable = false;
+		m_file = nullptr;
+		m_mapping = nullptr;
+	}
+
+#else
+
+	bool MappedFile::Open(const std::string& path, bool writable) {
+		Close();
+		const int file = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+		if (file < 0) {
+			return false;
+		}
+		struct stat info;
+		if (::fstat(file, &info) != 0 || info.st_size <= 0) {
+			::close(file);
+			return false;
+		}
+		const auto size = static_cast<size_t>(info.st_size);
+		void* data = ::mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+		// the mapping keeps the file
+		::close(file);
+		if (data == MAP_FAILED) {
+			return false;
+		}
+		m_data = static_cast<std::byte*>(data);
+		m_size = size;
+		m_writable = writable;
+		return true;
+	}
+
+	bool MappedFile::Create(const std::string& path, size_t size) {
+		Close();
+		const int file = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (file < 0) {
+			return false;
+		}
+		const bool resized = ::ftruncate(file, static_cast<off_t>(size)) == 0;
+		::close(file);
+		return resized && Open(path, true);
+	}
+
+	void MappedFile::Close() noexcept {
+		if (m_data) {
+			::munmap(m_data, m_size);
+		}
+		m_data = nullptr;
+		m_size = 0;
+		m_writable = false;
+	}
+
+#endif
+
+} // namespace tree::detail
@@ -0,0 +1,702 @@
+#pragma once
+
+#include "healthy.h"
+#include "Cardinals.h"
+#include "InlineStack.h"
+#include "QuadTree.h"
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tree {
+
+	enum class FlatStatus {
+		OK,
+		// the file can't be opened, mapped or written
+		IO_ERROR,
+		// the file isn't a flat tree or it is truncated
+		BAD_FORMAT,
+		// the file is written by another version of the format
+		BAD_VERSION,
+		// the file keeps another type of coordinates or payload
+		TYPE_MISMATCH,
+		// the content of the file doesn't match its checksum
+		BAD_CHECKSUM,
+		// the format is little-endian, the platform isn't
+		UNSUPPORTED_PLATFORM,
+		// the tree has more points than 32-bit indices of the format can refer to
+		TOO_LARGE,
+		// the nodes don't form a tree in pre-order or refer to points outside of the file
+		CORRUPT
+	};
+
+	namespace detail {
+
+		/**
+		 * Header of the file of the flat tree. Everything is little-endian.
+		 * Sections of nodes, xs, ys and values follow the header,
+		 * each of them starts at the multiple of FLAT_ALIGNMENT and is padded with zeros up to it.
+		 */
+		struct FlatHeader {
+			std::array<char, 8> magic;
+			uint32_t version;
+			// size of the coordinate and FLAT_FLOATING for floating point ones
+			uint32_t coordType;
+			// 0 when the payload is empty
+			uint32_t payloadSize;
+			uint32_t nodeSize;
+			uint64_t nodeCount;
+			uint64_t pointCount;
+			// offsets of the sections from the start of the file
+			uint64_t nodes;
+			uint64_t xs;
+			uint64_t ys;
+			uint64_t values;
+			uint64_t fileSize;
+			// checksum of everything after the header (see Checksum)
+			uint64_t checksum;
+		};
+
+		constexpr std::array<char, 8> FLAT_MAGIC{ 'Q', 'T', 'R', 'E', 'E', 'F', 'L', 'T' };
+		constexpr uint32_t FLAT_VERSION{ 2 };
+		constexpr uint32_t FLAT_FLOATING{ 0x100 };
+		constexpr size_t FLAT_ALIGNMENT{ 64 };
+		// the header takes the whole first aligned block(s)
+		constexpr size_t FLAT_HEADER_SIZE{ (sizeof(FlatHeader) + FLAT_ALIGNMENT - 1) / FLAT_ALIGNMENT * FLAT_ALIGNMENT };
+
+		bool IsLittleEndian() noexcept;
+
+		// return the header of the file with the sections of the given sizes, the checksum isn't set
+		FlatHeader MakeFlatHeader(
+			uint32_t coordType, uint32_t payloadSize, uint32_t nodeSize, uint64_t nodeCount, uint64_t pointCount
+		) noexcept;
+
+		/**
+		 * 64-bit FNV-1a over little-endian 64-bit words with extra mixing of the high bits.
+		 * Data may be fed in pieces of any size: the result depends only on the concatenation.
+		 */
+		class Checksum {
+		public:
+			void Update(const void* data, size_t size) noexcept;
+
+			// the pending bytes of the incomplete word are padded with zeros
+			uint64_t GetValue() const noexcept;
+
+		private:
+			static uint64_t Mix(uint64_t hash, uint64_t word) noexcept;
+
+		private:
+			uint64_t m_hash{ 0xcbf29ce484222325ull };
+			std::array<unsigned char, 8> m_pending{};
+			size_t m_pendingSize{ 0 };
+		};
+
+		/**
+		 * Check the header of the mapped file and the bounds of its sections against
+		 * the expected types. The checksum is checked on request: it reads the whole file.
+		 */
+		FlatStatus CheckFlatFile(
+			const std::byte* data, size_t size,
+			uint32_t coordType, uint32_t payloadSize, uint32_t nodeSize, bool verifyChecksum
+		) noexcept;
+
+		// mapping of the whole file shared with other processes mapping it
+		class MappedFile {
+		public:
+			MappedFile() = default;
+
+			~MappedFile();
+
+			MappedFile(MappedFile&& other) noexcept;
+			MappedFile& operator=(MappedFile&& other) noexcept;
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			// map the existing file, it can be modified through the writable mapping
+			bool Open(const std::string& path, bool writable = false);
+
+			// create the file of the given size (or truncate the existing one) and map it writable
+			bool Create(const std::string& path, size_t size);
+
+			void Close() noexcept;
+
+			const std::byte* GetData() const noexcept {
+				return m_data;
+			}
+
+			// return the data of the writable mapping
+			std::byte* GetMutableData() const noexcept {
+				assert(m_writable && "The file is mapped read-only");
+				return m_data;
+			}
+
+			size_t GetSize() const noexcept {
+				return m_size;
+			}
+
+		private:
+			std::byte* m_data{ nullptr };
+			size_t m_size{ 0 };
+			bool m_writable{ false };
+		#ifdef _WIN32
+			void* m_file{ nullptr };
+			void* m_mapping{ nullptr };
+		#endif
+		};
+
+	} // namespace detail
+
+	// node of the flat tree, children of the node follow it in pre-order
+	template<class Coord>
+	struct FlatNode {
+		static constexpr uint32_t NONE{ std::numeric_limits<uint32_t>::max() };
+
+		mt::BasicRect<Coord> m_box{ 0, 0, 0, 0 };
+		// the point dividing the box when the division is Division::CENTER
+		mt::BasicPt<Coord> m_center;
+		// index of the child for each quarter or NONE
+		std::array<uint32_t, Cardinals::COUNT> m_children;
+		// own points are [m_firstPoint, m_firstPoint + m_size),
+		// points of the subtree are [m_firstPoint, m_firstPoint + m_count)
+		uint32_t m_firstPoint;
+		uint32_t m_size;
+		uint32_t m_count;
+		// tree::Division stored in 32 bits
+		uint32_t m_division;
+
+		/**
+		 * Fill the node without children. The node may have padding (e.g. after the coordinates of one byte),
+		 * so it's zeroed first: the same tree is written to the same bytes by `Write` and FlatTreeBuilder.
+		 */
+		void Assign(
+			const mt::BasicRect<Coord>& box, const mt::BasicPt<Coord>& center,
+			uint32_t firstPoint, uint32_t size, uint32_t count, Division division
+		) noexcept {
+			std::memset(static_cast<void*>(this), 0, sizeof(*this));
+			m_box = box;
+			m_center = center;
+			m_children.fill(NONE);
+			m_firstPoint = firstPoint;
+			m_size = size;
+			m_count = count;
+			m_division = static_cast<uint32_t>(division);
+		}
+
+		Division GetDivision() const noexcept {
+			return static_cast<Division>(m_division);
+		}
+	};
+
+	/**
+	 * Read-only quad tree mapped from the file written by `Write`.
+	 *
+	 * The file is a flat pointer-free image of the tree: the array of nodes in pre-order
+	 * and the arrays of coordinates and payloads in the same order, so the points of any subtree
+	 * are contiguous. Opening the file maps it without parsing or allocation:
+	 * the tree can be queried at once and the pages are shared by the processes mapping the same file.
+	 * Handles and aggregates of the source tree aren't kept.
+	 *
+	 * @tparam Payload trivially copyable value stored with each point
+	 * @tparam Coord type of coordinates
+	 */
+	template<class Payload = NoPayload, class Coord = float>
+	class FlatQuadTree {
+		static_assert(std::is_trivially_copyable_v<Payload>, "Payload is stored as bytes");
+		static_assert(std::is_arithmetic_v<Coord>, "Coordinates are stored as bytes");
+
+	public:
+		using Point = mt::BasicPt<Coord>;
+		using Rect = mt::BasicRect<Coord>;
+		using Node = FlatNode<Coord>;
+
+		static constexpr bool HAS_PAYLOAD{ !std::is_empty_v<Payload> };
+
+		// the tree which isn't opened is empty
+		FlatQuadTree() = default;
+
+		FlatQuadTree(FlatQuadTree&& other) noexcept;
+		FlatQuadTree& operator=(FlatQuadTree&& other) noexcept;
+
+		/**
+		 * Write the tree to the file in the flat format.
+		 * The tree is flattened in memory first, so it takes about the size of the file.
+		 */
+		template<size_t LeafCapacity, class Aggregate>
+		static FlatStatus Write(const QuadTree<Payload, Coord, LeafCapacity, Aggregate>& tree, const std::string& path);
+
+		/**
+		 * Map the file written by `Write`. The previously opened file is closed.
+		 * The nodes are always checked, so queries stay inside the file even if it's corrupt or crafted.
+		 * Without checksum verification the coordinates and the payloads aren't read.
+		 */
+		FlatStatus Open(const std::string& path, bool verifyChecksum = true);
+
+		void Close() noexcept;
+
+		bool IsOpen() const noexcept;
+
+		// return all of points in the area
+		std::vector<Point> GetPointsAt(const Rect& area) const;
+
+		/**
+		 * Call `visitor(point, value)` for each point in the area.
+		 * The visitor may return false to stop the traversal early.
+		 * Return false if the traversal was stopped by the visitor.
+		 */
+		template<class Visitor>
+		bool ForEachAt(const Rect& area, Visitor&& visitor) const;
+
+		// return number of points in the area
+		size_t CountPointsAt(const Rect& area) const noexcept;
+
+		bool Contains(const Point& point) const noexcept;
+
+		// return the value stored with the point or nullptr if there is no such point
+		const Payload* Find(const Point& point) const noexcept;
+
+		bool IsEmpty() const noexcept;
+
+		// return number of points in the tree
+		size_t GetSize() const noexcept;
+
+		// return the box of the root, the tree must be opened
+		Rect GetBox() const noexcept;
+
+		static constexpr uint32_t COORD_TYPE{
+			static_cast<uint32_t>(sizeof(Coord)) | (std::is_floating_point_v<Coord> ? detail::FLAT_FLOATING : 0u)
+		};
+		static constexpr uint32_t PAYLOAD_SIZE{ HAS_PAYLOAD ? static_cast<uint32_t>(sizeof(Payload)) : 0u };
+
+	private:
+		static constexpr size_t INLINE_STACK_SIZE{ 128 };
+
+		/**
+		 * Whether the nodes are laid out in pre-order as `Flatten` does: each node is visited once,
+		 * children follow their parent, and own points and points of the subtree are within the point count.
+		 */
+		static bool CheckNodes(const Node* nodes, uint64_t nodeCount, uint64_t pointCount);
+
+		// return number of nodes of the subtree, stop counting once it's over the limit
+		template<class SourceNode>
+		static size_t CountNodes(const SourceNode* node, size_t limit);
+
+		// append the subtree in pre-order and return index of its root
+		template<class SourceNode>
+		static uint32_t Flatten(
+			const SourceNode* node, std::vector<Node>& nodes,
+			std::vector<Coord>& xs, std::vector<Coord>& ys, std::vector<Payload>& values
+		);
+
+		/**
+		 * Call `onRange(first, last)` for the subtrees inside the area
+		 * and `onPoint(index)` for the other points in the area.
+		 * Stop when any of them returns false and return false.
+		 */
+		template<class OnRange, class OnPoint>
+		bool Traverse(const Rect& area, OnRange&& onRange, OnPoint&& onPoint) const;
+
+		const Payload& GetValue(size_t index) const noexcept;
+
+	private:
+		detail::MappedFile m_file;
+		const Node* m_nodes{ nullptr };
+		const Coord* m_xs{ nullptr };
+		const Coord* m_ys{ nullptr };
+		const Payload* m_values{ nullptr };
+		size_t m_size{ 0 };
+	};
+
+	namespace detail {
+
+		// write the data followed by zeros up to FLAT_ALIGNMENT
+		void WriteFlatSection(std::ostream& out, const void* data, size_t size, Checksum& checksum);
+
+		// return the size of the data padded up to FLAT_ALIGNMENT
+		constexpr uint64_t GetFlatSectionSize(uint64_t size) noexcept {
+			return (size + FLAT_ALIGNMENT - 1) / FLAT_ALIGNMENT * FLAT_ALIGNMENT;
+		}
+
+	} // namespace detail
+
+	template<class Payload, class Coord>
+	FlatQuadTree<Payload, Coord>::FlatQuadTree(FlatQuadTree&& other) noexcept {
+		*this = std::move(other);
+	}
+
+	template<class Payload, class Coord>
+	FlatQuadTree<Payload, Coord>& FlatQuadTree<Payload, Coord>::operator=(FlatQuadTree&& other) noexcept {
+		if (this != &other) {
+			m_file = std::move(other.m_file);
+			m_nodes = std::exchange(other.m_nodes, nullptr);
+			m_xs = std::exchange(other.m_xs, nullptr);
+			m_ys = std::exchange(other.m_ys, nullptr);
+			m_values = std::exchange(other.m_values, nullptr);
+			m_size = std::exchange(other.m_size, 0);
+		}
+		return *this;
+	}
+
+	template<class Payload, class Coord>
+	template<size_t LeafCapacity, class Aggregate>
+	FlatStatus FlatQuadTree<Payload, Coord>::Write(
+		const QuadTree<Payload, Coord, LeafCapacity, Aggregate>& tree, const std::string& path
+	) {
+		if (!detail::IsLittleEndian()) {
+			return FlatStatus::UNSUPPORTED_PLATFORM;
+		}
+		// indices of the format are 32 bits
+		constexpr size_t MAX_INDEX{ std::numeric_limits<uint32_t>::max() };
+		if (tree.GetSize() > MAX_INDEX || CountNodes(tree.m_root, MAX_INDEX) > MAX_INDEX) {
+			return FlatStatus::TOO_LARGE;
+		}
+		std::vector<Node> nodes;
+		std::vector<Coord> xs;
+		std::vector<Coord> ys;
+		std::vector<Payload> values;
+		xs.reserve(tree.GetSize());
+		ys.reserve(tree.GetSize());
+		if constexpr (HAS_PAYLOAD) {
+			values.reserve(tree.GetSize());
+		}
+		Flatten(tree.m_root, nodes, xs, ys, values);
+
+		auto header = detail::MakeFlatHeader(
+			COORD_TYPE, PAYLOAD_SIZE, static_cast<uint32_t>(sizeof(Node)), nodes.size(), xs.size()
+		);
+
+		std::ofstream out{ path, std::ios::binary | std::ios::trunc };
+		if (!out) {
+			return FlatStatus::IO_ERROR;
+		}
+		// the header is written last: it has the checksum of the sections
+		const std::array<char, detail::FLAT_HEADER_SIZE> placeholder{};
+		out.write(placeholder.data(), placeholder.size());
+		detail::Checksum checksum;
+		detail::WriteFlatSection(out, nodes.data(), nodes.size() * sizeof(Node), checksum);
+		detail::WriteFlatSection(out, xs.data(), xs.size() * sizeof(Coord), checksum);
+		detail::WriteFlatSection(out, ys.data(), ys.size() * sizeof(Coord), checksum);
+		detail::WriteFlatSection(out, values.data(), values.size() * sizeof(Payload), checksum);
+		header.checksum = checksum.GetValue();
+		out.seekp(0);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.flush();
+		return out ? FlatStatus::OK : FlatStatus::IO_ERROR;
+	}
+
+	template<class Payload, class Coord>
+	template<class SourceNode>
+	size_t FlatQuadTree<Payload, Coord>::CountNodes(const SourceNode* node, size_t limit) {
+		size_t count{ 0 };
+		InlineStack<const SourceNode*, INLINE_STACK_SIZE> pending;
+		pending.Push(node);
+		while (!pending.IsEmpty() && count <= limit) {
+			const auto current = pending.Pop();
+			count++;
+			for (const auto child : current->m_children) {
+				if (child) {
+					pending.Push(child);
+				}
+			}
+		}
+		return count;
+	}
+
+	/**
+	 * The children are taken from the stack in order of quarters, so the subtree of each child
+	 * follows the one of the previous child. The counts are collected from the last node.
+	 */
+	template<class Payload, class Coord>
+	template<class SourceNode>
+	uint32_t FlatQuadTree<Payload, Coord>::Flatten(
+		const SourceNode* node, std::vector<Node>& nodes,
+		std::vector<Coord>& xs, std::vector<Coord>& ys, std::vector<Payload>& values
+	) {
+		// the source node and the child of its flat parent it becomes
+		struct Pending {
+			const SourceNode* node;
+			uint32_t parent;
+			uint32_t quarter;
+		};
+
+		const auto root = static_cast<uint32_t>(nodes.size());
+		InlineStack<Pending, INLINE_STACK_SIZE> pending;
+		pending.Push({ node, Node::NONE, 0 });
+		while (!pending.IsEmpty()) {
+			const auto current = pending.Pop();
+			const auto index = static_cast<uint32_t>(nodes.size());
+			nodes.emplace_back().Assign(
+				current.node->m_box,
+				current.node->m_center,
+				static_cast<uint32_t>(xs.size()),
+				static_cast<uint32_t>(current.node->m_size),
+				0,
+				current.node->m_division
+			);
+			if (current.parent != Node::NONE) {
+				nodes[current.parent].m_children[current.quarter] = index;
+			}
+			for (size_t i = 0; i < current.node->m_size; i++) {
+				xs.push_back(current.node->m_xs[i]);
+				ys.push_back(current.node->m_ys[i]);
+				if constexpr (HAS_PAYLOAD) {
+					values.push_back(current.node->m_values[i]);
+				}
+			}
+			for (size_t i = Cardinals::COUNT; i-- > 0; ) {
+				if (current.node->m_children[i]) {
+					pending.Push({ current.node->m_children[i], index, static_cast<uint32_t>(i) });
+				}
+			}
+		}
+
+		// the children follow their parents
+		for (size_t i = nodes.size(); i-- > root; ) {
+			auto& flat = nodes[i];
+			flat.m_count = flat.m_size;
+			for (const auto child : flat.m_children) {
+				if (child != Node::NONE) {
+					flat.m_count += nodes[child].m_count;
+				}
+			}
+		}
+		return root;
+	}
+
+	template<class Payload, class Coord>
+	FlatStatus FlatQuadTree<Payload, Coord>::Open(const std::string& path, bool verifyChecksum) {
+		Close();
+		if (!detail::IsLittleEndian()) {
+			return FlatStatus::UNSUPPORTED_PLATFORM;
+		}
+		detail::MappedFile file;
+		if (!file.Open(path)) {
+			return FlatStatus::IO_ERROR;
+		}
+		const auto status = detail::CheckFlatFile(
+			file.GetData(), file.GetSize(), COORD_TYPE, PAYLOAD_SIZE, static_cast<uint32_t>(sizeof(Node)), verifyChecksum
+		);
+		if (status != FlatStatus::OK) {
+			return status;
+		}
+
+		detail::FlatHeader header;
+		std::memcpy(&header, file.GetData(), sizeof(header));
+		const auto data = file.GetData();
+		const auto nodes = reinterpret_cast<const Node*>(data + header.nodes);
+		if (!CheckNodes(nodes, header.nodeCount, header.pointCount)) {
+			return FlatStatus::CORRUPT;
+		}
+		m_nodes = nodes;
+		m_xs = reinterpret_cast<const Coord*>(data + header.xs);
+		m_ys = reinterpret_cast<const Coord*>(data + header.ys);
+		m_values = reinterpret_cast<const Payload*>(data + header.values);
+		m_size = static_cast<size_t>(header.pointCount);
+		m_file = std::move(file);
+		return FlatStatus::OK;
+	}
+
+	/**
+	 * The nodes are taken from the stack like in `Flatten`, so the tree in pre-order
+	 * pops them in order of their indices. A node referred twice or out of order breaks the sequence.
+	 */
+	template<class Payload, class Coord>
+	bool FlatQuadTree<Payload, Coord>::CheckNodes(const Node* nodes, uint64_t nodeCount, uint64_t pointCount) {
+		uint64_t visited{ 0 };
+		InlineStack<uint32_t, INLINE_STACK_SIZE> pending;
+		pending.Push(0);
+		while (!pending.IsEmpty()) {
+			const auto index = pending.Pop();
+			if (index != visited || visited == nodeCount) {
+				return false;
+			}
+			visited++;
+			const Node& node = nodes[index];
+			if (node.m_size > node.m_count
+				|| uint64_t{ node.m_firstPoint } + node.m_count > pointCount
+				|| node.m_division > static_cast<uint32_t>(Division::NONE)
+			) {
+				return false;
+			}
+			for (size_t i = Cardinals::COUNT; i-- > 0; ) {
+				const auto child = node.m_children[i];
+				if (child == Node::NONE) {
+					continue;
+				}
+				if (child <= index || child >= nodeCount) {
+					return false;
+				}
+				pending.Push(child);
+			}
+		}
+		return visited == nodeCount;
+	}
+
+	template<class Payload, class Coord>
+	void FlatQuadTree<Payload, Coord>::Close() noexcept {
+		m_file.Close();
+		m_nodes = nullptr;
+		m_xs = nullptr;
+		m_ys = nullptr;
+		m_values = nullptr;
+		m_size = 0;
+	}
+
+	template<class Payload, class Coord>
+	bool FlatQuadTree<Payload, Coord>::IsOpen() const noexcept {
+		return m_nodes != nullptr;
+	}
+
+	template<class Payload, class Coord>
+	template<class OnRange, class OnPoint>
+	bool FlatQuadTree<Payload, Coord>::Traverse(const Rect& area, OnRange&& onRange, OnPoint&& onPoint) const {
+		if (!m_nodes) {
+			return true;
+		}
+		InlineStack<uint32_t, INLINE_STACK_SIZE> processed;
+		processed.Push(0);
+
+		while (!processed.IsEmpty()) {
+			const Node& current = m_nodes[processed.Pop()];
+			// all of points of the subtree are in the area
+			if (area.Covers(current.m_box)) {
+				if (!onRange(current.m_firstPoint, current.m_firstPoint + current.m_count)) {
+					return false;
+				}
+				continue;
+			}
+
+			const size_t last = current.m_firstPoint + current.m_size;
+			for (size_t i = current.m_firstPoint; i < last; i++) {
+				if (area.Contains(m_xs[i], m_ys[i]) && !onPoint(i)) {
+					return false;
+				}
+			}
+			const unsigned quarters = simd::IntersectQuarters(current.m_box, current.GetDivision(), current.m_center, area);
+			for (size_t i = 0; i < Cardinals::COUNT; i++) {
+				if (current.m_children[i] != Node::NONE && (quarters & (1u << i))) {
+					processed.Push(current.m_children[i]);
+				}
+			}
+		}
+		return true;
+	}
+
+	template<class Payload, class Coord>
+	auto FlatQuadTree<Payload, Coord>::GetPointsAt(const Rect& area) const -> std::vector<Point> {
+		std::vector<Point> points;
+		Traverse(area,
+			[this, &points](size_t first, size_t last) {
+				for (size_t i = first; i < last; i++) {
+					points.emplace_back(m_xs[i], m_ys[i]);
+				}
+				return true;
+			},
+			[this, &points](size_t index) {
+				points.emplace_back(m_xs[index], m_ys[index]);
+				return true;
+			}
+		);
+		return points;
+	}
+
+	template<class Payload, class Coord>
+	template<class Visitor>
+	bool FlatQuadTree<Payload, Coord>::ForEachAt(const Rect& area, Visitor&& visitor) const {
+		return Traverse(area,
+			[this, &visitor](size_t first, size_t last) {
+				for (size_t i = first; i < last; i++) {
+					if (!detail::Visit(visitor, Point{ m_xs[i], m_ys[i] }, GetValue(i))) {
+						return false;
+					}
+				}
+				return true;
+			},
+			[this, &visitor](size_t index) {
+				return detail::Visit(visitor, Point{ m_xs[index], m_ys[index] }, GetValue(index));
+			}
+		);
+	}
+
+	template<class Payload, class Coord>
+	size_t FlatQuadTree<Payload, Coord>::CountPointsAt(const Rect& area) const noexcept {
+		size_t total{ 0 };
+		Traverse(area,
+			[&total](size_t first, size_t last) {
+				total += last - first;
+				return true;
+			},
+			[&total](size_t) {
+				total++;
+				return true;
+			}
+		);
+		return total;
+	}
+
+	template<class Payload, class Coord>
+	bool FlatQuadTree<Payload, Coord>::Contains(const Point& point) const noexcept {
+		return Find(point) != nullptr;
+	}
+
+	template<class Payload, class Coord>
+	const Payload* FlatQuadTree<Payload, Coord>::Find(const Point& point) const noexcept {
+		if (!m_nodes) {
+			return nullptr;
+		}
+		uint32_t index{ 0 };
+		while (index != Node::NONE) {
+			const Node& node = m_nodes[index];
+			if (!node.m_box.Contains(point)) {
+				return nullptr;
+			}
+			const size_t last = node.m_firstPoint + node.m_size;
+			for (size_t i = node.m_firstPoint; i < last; i++) {
+				if (m_xs[i] == point.x && m_ys[i] == point.y) {
+					return &GetValue(i);
+				}
+			}
+			// own points of the overflow leaf were checked, the rest is in its child
+			index = node.m_children[GetQuarter(point, node.m_box, node.GetDivision(), node.m_center)];
+		}
+		return nullptr;
+	}
+
+	template<class Payload, class Coord>
+	const Payload& FlatQuadTree<Payload, Coord>::GetValue(size_t index) const noexcept {
+		if constexpr (HAS_PAYLOAD) {
+			return m_values[index];
+		}
+		else {
+			// empty payloads aren't stored
+			static const Payload empty{};
+			(void)index;
+			return empty;
+		}
+	}
+
+	template<class Payload, class Coord>
+	bool FlatQuadTree<Payload, Coord>::IsEmpty() const noexcept {
+		return m_size == 0;
+	}
+
+	template<class Payload, class Coord>
+	size_t FlatQuadTree<Payload, Coord>::GetSize() const noexcept {
+		return m_size;
+	}
+
+	template<class Payload, class Coord>
+	auto FlatQuadTree<Payload, Coord>::GetBox() const noexcept -> Rect {
+		assert(m_nodes && "The tree isn't opened");
+		return m_nodes[0].m_box;
+	}
+
+} // namespace tree
@@ -0,0 +1,533 @@
+#pragma once
+
+#include "healthy.h"
+#include "Cardinals.h"
+#include "Morton.h"
+#include "FlatQuadTree.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+namespace tree {
+
+	enum class BuildStage {
+		// points are added, sorted and spilled to the runs
+		SORT,
+		// the runs are merged into one sorted file
+		MERGE,
+		// the shape of the tree is computed to lay out the file
+		LAYOUT,
+		// nodes and points are written to the file
+		WRITE
+	};
+
+	struct BuildProgress {
+		BuildStage stage;
+		// number of points processed at this stage
+		uint64_t done;
+		// number of points to process at this stage (0 when unknown)
+		uint64_t total;
+	};
+
+	struct FlatBuildOptions {
+		// memory used for sorting and merging the points
+		size_t memoryLimit{ size_t{ 1 } << 30 };
+		// directory of the temporary files, the system one when empty
+		std::string tempDirectory;
+		// called after each run and every million of points otherwise
+		std::function<void(const BuildProgress&)> progress;
+		// depth of the overflow leaves, the same as the one of QuadTree (see QuadTree::SetSplitPolicy)
+		size_t maxDepth{ DEFAULT_MAX_DEPTH };
+		// minimum size of the quarters converted to the coordinates (see QuadTree::SetMinCellSize)
+		double minCellSize{ 0.0 };
+	};
+
+	/**
+	 * Builder of the flat tree (see FlatQuadTree) from the points which don't fit in memory.
+	 *
+	 * The added points are collected until the memory limit, sorted in Morton order and spilled
+	 * to the temporary runs. `Finish` merges the runs into one sorted file removing repeated points,
+	 * then lays the tree out walking the sorted file through the mapping: once to count the nodes
+	 * and once to write them to the mapped output.
+	 * The result is the file `FlatQuadTree::Write` writes for `QuadTree::Build` of the same points
+	 * in the order they were added.
+	 */
+	template<class Payload = NoPayload, class Coord = float, size_t LeafCapacity = DEFAULT_LEAF_CAPACITY>
+	class FlatTreeBuilder {
+	public:
+		using Point = mt::BasicPt<Coord>;
+		using Rect = mt::BasicRect<Coord>;
+		using Flat = FlatQuadTree<Payload, Coord>;
+		using Node = typename Flat::Node;
+
+		static constexpr size_t MAX_POINTS{ LeafCapacity };
+
+		explicit FlatTreeBuilder(const Rect& fullArea, FlatBuildOptions options = {});
+
+		// remove the temporary files
+		~FlatTreeBuilder();
+
+		FlatTreeBuilder(const FlatTreeBuilder&) = delete;
+		FlatTreeBuilder& operator=(const FlatTreeBuilder&) = delete;
+
+		/**
+		 * Add the point unless it is outside the boundary.
+		 * Return false if the run can't be spilled: `Finish` reports the error then.
+		 */
+		bool Add(const Point& point, Payload value = {});
+
+		bool Add(const std::vector<Point>& points);
+
+		// write the tree of all of added points to the file, the builder is left empty
+		FlatStatus Finish(const std::string& path);
+
+	private:
+		struct Record {
+			uint64_t code;
+			// order of the point among added ones: the first of repeated points is kept
+			uint64_t sequence;
+			Point point;
+			Payload value;
+		};
+
+		static bool IsLess(const Record& lhs, const Record& rhs) noexcept;
+
+		// sort the collected points and write them to the new run
+		bool Spill();
+
+		// merge the runs into the sorted file without repeated points, return number of its points
+		bool Merge(const std::string& path, uint64_t& count);
+
+		/**
+		 * Lay out the subtree of the points [first, last) like QuadTree::Build does
+		 * and return number of its points.
+		 * Points lost by rounding of the quarters' boundaries are moved to the end of the range.
+		 * Without the output the nodes are only counted.
+		 */
+		size_t Layout(Record* first, Record* last, const Rect& box, size_t level);
+
+		// lay out the chain of overflow leaves of the points [first, last) and return number of its points
+		size_t LayoutOverflow(Record* first, Record* last, const Rect& box);
+
+		// write the points [first, last) to the output starting from `index` and report the progress
+		void WritePoints(const Record* first, const Record* last, uint64_t index);
+
+		// move the points which are outside the box to the end keeping the order, return the end of the rest
+		static Record* KeepInside(Record* first, Record* last, const Rect& box);
+
+		std::string MakeTempPath(const char* kind);
+
+		void Report(BuildStage stage, uint64_t done, uint64_t total) const;
+
+	private:
+		Rect m_box;
+		FlatBuildOptions m_options;
+		std::vector<Record> m_buffer;
+		size_t m_bufferCapacity{ 0 };
+		std::vector<std::string> m_runs;
+		uint64_t m_added{ 0 };
+		uint64_t m_spilled{ 0 };
+		bool m_failed{ false };
+		// prefix of the temporary files of this builder
+		std::string m_tempPrefix;
+		size_t m_tempFiles{ 0 };
+
+		// state of the layout
+		Node* m_nodes{ nullptr };
+		Coord* m_xs{ nullptr };
+		Coord* m_ys{ nullptr };
+		Payload* m_values{ nullptr };
+		uint64_t m_nodeCount{ 0 };
+		uint64_t m_pointCount{ 0 };
+		uint64_t m_totalPoints{ 0 };
+	};
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	FlatTreeBuilder<Payload, Coord, LeafCapacity>::FlatTreeBuilder(const Rect& fullArea, FlatBuildOptions options)
+		: m_box{ fullArea }
+		, m_options{ std::move(options) }
+		, m_bufferCapacity{ std::max(m_options.memoryLimit / sizeof(Record), size_t{ 1024 }) }
+	{
+		const auto directory = m_options.tempDirectory.empty()
+			? std::filesystem::temp_directory_path()
+			: std::filesystem::path{ m_options.tempDirectory };
+		// the address and the time tell apart builders of this and other processes
+		const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+		m_tempPrefix = (directory / ("qtree_" + std::to_string(reinterpret_cast<uintptr_t>(this))
+			+ "_" + std::to_string(stamp))).string();
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	FlatTreeBuilder<Payload, Coord, LeafCapacity>::~FlatTreeBuilder() {
+		for (const auto& run : m_runs) {
+			std::remove(run.c_str());
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool FlatTreeBuilder<Payload, Coord, LeafCapacity>::Add(const Point& point, Payload value) {
+		const auto sequence = m_added++;
+		// point is outside the boundary
+		if (!m_box.Contains(point)) {
+			return !m_failed;
+		}
+		if (m_buffer.capacity() == 0) {
+			m_buffer.reserve(m_bufferCapacity);
+		}
+		m_buffer.push_back({ GetMortonCode(point, m_box), sequence, point, value });
+		if (m_buffer.size() == m_bufferCapacity) {
+			Spill();
+		}
+		return !m_failed;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool FlatTreeBuilder<Payload, Coord, LeafCapacity>::Add(const std::vector<Point>& points) {
+		for (const auto& point : points) {
+			Add(point);
+		}
+		return !m_failed;
+	}
+
+	/**
+	 * Order of QuadTree::Build: by Morton code, the points of the same code are ordered
+	 * by coordinates to find the repeated ones and the repeated points by the order they were added.
+	 */
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool FlatTreeBuilder<Payload, Coord, LeafCapacity>::IsLess(const Record& lhs, const Record& rhs) noexcept {
+		if (lhs.code != rhs.code) {
+			return lhs.code < rhs.code;
+		}
+		if (lhs.point.x < rhs.point.x || rhs.point.x < lhs.point.x) {
+			return lhs.point.x < rhs.point.x;
+		}
+		if (lhs.point.y < rhs.point.y || rhs.point.y < lhs.point.y) {
+			return lhs.point.y < rhs.point.y;
+		}
+		return lhs.sequence < rhs.sequence;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool FlatTreeBuilder<Payload, Coord, LeafCapacity>::Spill() {
+		if (m_failed || m_buffer.empty()) {
+			m_buffer.clear();
+			return !m_failed;
+		}
+		std::sort(m_buffer.begin(), m_buffer.end(), IsLess);
+		m_runs.push_back(MakeTempPath("run"));
+		std::ofstream out{ m_runs.back(), std::ios::binary | std::ios::trunc };
+		out.write(reinterpret_cast<const char*>(m_buffer.data()), static_cast<std::streamsize>(m_buffer.size() * sizeof(Record)));
+		m_failed = !out.flush();
+		m_spilled += m_buffer.size();
+		m_buffer.clear();
+		Report(BuildStage::SORT, m_spilled, 0);
+		return !m_failed;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool FlatTreeBuilder<Payload, Coord, LeafCapacity>::Merge(const std::string& path, uint64_t& count) {
+		struct Run {
+			std::ifstream in;
+			std::vector<Record> buffer;
+			size_t next{ 0 };
+
+			// return false when the run is over
+			bool Refill(size_t capacity) {
+				buffer.resize(capacity);
+				in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(capacity * sizeof(Record)));
+				buffer.resize(static_cast<size_t>(in.gcount()) / sizeof(Record));
+				next = 0;
+				return !buffer.empty();
+			}
+		};
+
+		// the memory is shared by the buffers of the runs and the output
+		const size_t capacity = std::max(m_options.memoryLimit / sizeof(Record) / (m_runs.size() + 1), size_t{ 1024 });
+		std::vector<Run> runs(m_runs.size());
+		const auto isGreater = [&runs](size_t lhs, size_t rhs) {
+			return IsLess(runs[rhs].buffer[runs[rhs].next], runs[lhs].buffer[runs[lhs].next]);
+		};
+		std::priority_queue<size_t, std::vector<size_t>, decltype(isGreater)> heads{ isGreater };
+		for (size_t i = 0; i < runs.size(); i++) {
+			runs[i].in.open(m_runs[i], std::ios::binary);
+			if (!runs[i].in) {
+				return false;
+			}
+			if (runs[i].Refill(capacity)) {
+				heads.push(i);
+			}
+		}
+
+		std::ofstream out{ path, std::ios::binary | std::ios::trunc };
+		std::vector<Record> output;
+		output.reserve(capacity);
+		const auto flush = [&out, &output]() {
+			out.write(reinterpret_cast<const char*>(output.data()), static_cast<std::streamsize>(output.size() * sizeof(Record)));
+			output.clear();
+		};
+
+		uint64_t merged{ 0 };
+		count = 0;
+		Record previous{};
+		while (!heads.empty()) {
+			const auto index = heads.top();
+			heads.pop();
+			auto& run = runs[index];
+			const Record& record = run.buffer[run.next];
+			// repeated points are adjacent and the first added one goes first
+			if (merged == 0 || record.code != previous.code || record.point != previous.point) {
+				output.push_back(record);
+				count++;
+				if (output.size() == capacity) {
+					flush();
+				}
+			}
+			previous = record;
+			merged++;
+			if (merged % (1 << 20) == 0) {
+				Report(BuildStage::MERGE, merged, m_spilled);
+			}
+			if (++run.next < run.buffer.size() || run.Refill(capacity)) {
+				heads.push(index);
+			}
+		}
+		flush();
+		Report(BuildStage::MERGE, merged, m_spilled);
+		return static_cast<bool>(out.flush());
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	FlatStatus FlatTreeBuilder<Payload, Coord, LeafCapacity>::Finish(const std::string& path) {
+		if (!detail::IsLittleEndian()) {
+			return FlatStatus::UNSUPPORTED_PLATFORM;
+		}
+		Spill();
+		if (m_failed) {
+			return FlatStatus::IO_ERROR;
+		}
+
+		const auto sortedPath = MakeTempPath("sorted");
+		uint64_t count{ 0 };
+		const bool merged = Merge(sortedPath, count);
+		// the sorted file is removed with the runs
+		m_runs.push_back(sortedPath);
+		if (!merged) {
+			return FlatStatus::IO_ERROR;
+		}
+		if (count > std::numeric_limits<uint32_t>::max()) {
+			return FlatStatus::TOO_LARGE;
+		}
+
+		// the points lost by rounding are moved while counting the nodes,
+		// so the sorted file is mapped writable and the second pass sees the same order
+		detail::MappedFile sorted;
+		if (count > 0 && !sorted.Open(sortedPath, true)) {
+			return FlatStatus::IO_ERROR;
+		}
+		const auto first = count > 0 ? reinterpret_cast<Record*>(sorted.GetMutableData()) : nullptr;
+		const auto last = first + count;
+
+		m_nodes = nullptr;
+		m_nodeCount = 0;
+		m_pointCount = 0;
+		m_totalPoints = count;
+		Layout(first, last, m_box, 0);
+		if (m_nodeCount > std::numeric_limits<uint32_t>::max()) {
+			return FlatStatus::TOO_LARGE;
+		}
+
+		auto header = detail::MakeFlatHeader(
+			Flat::COORD_TYPE, Flat::PAYLOAD_SIZE, static_cast<uint32_t>(sizeof(Node)), m_nodeCount, m_pointCount
+		);
+		detail::MappedFile output;
+		if (!output.Create(path, static_cast<size_t>(header.fileSize))) {
+			return FlatStatus::IO_ERROR;
+		}
+		const auto data = output.GetMutableData();
+		m_nodes = reinterpret_cast<Node*>(data + header.nodes);
+		m_xs = reinterpret_cast<Coord*>(data + header.xs);
+		m_ys = reinterpret_cast<Coord*>(data + header.ys);
+		m_values = reinterpret_cast<Payload*>(data + header.values);
+		m_nodeCount = 0;
+		m_pointCount = 0;
+		Layout(first, last, m_box, 0);
+		m_nodes = nullptr;
+
+		// the file is created filled with zeros, so the padding of the sections is in place
+		detail::Checksum checksum;
+		checksum.Update(data + detail::FLAT_HEADER_SIZE, output.GetSize() - detail::FLAT_HEADER_SIZE);
+		header.checksum = checksum.GetValue();
+		std::memcpy(data, &header, sizeof(header));
+		output.Close();
+		sorted.Close();
+
+		for (const auto& run : m_runs) {
+			std::remove(run.c_str());
+		}
+		m_runs.clear();
+		m_added = 0;
+		m_spilled = 0;
+		return FlatStatus::OK;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	size_t FlatTreeBuilder<Payload, Coord, LeafCapacity>::Layout(Record* first, Record* last, const Rect& box, size_t level) {
+		if (level >= m_options.maxDepth || !IsDivisible(box, static_cast<Coord>(m_options.minCellSize))) {
+			return LayoutOverflow(first, last, box);
+		}
+		std::array<Record*, Cardinals::COUNT + 1> bounds;
+		bounds.front() = first;
+		bounds.back() = last;
+		if (level < MORTON_LEVELS) {
+			for (size_t i = 1; i < Cardinals::COUNT; i++) {
+				bounds[i] = std::partition_point(bounds[i - 1], last, [level, i](const Record& record) {
+					return GetQuarterAt(record.code, level) < i;
+				});
+			}
+		}
+		else {
+			// the code is exhausted: the range is small, so order it directly
+			std::stable_sort(first, last, [&box](const Record& lhs, const Record& rhs) {
+				return GetQuarter(lhs.point, box) < GetQuarter(rhs.point, box);
+			});
+			for (size_t i = 1; i < Cardinals::COUNT; i++) {
+				bounds[i] = std::partition_point(bounds[i - 1], last, [&box, i](const Record& record) {
+					return GetQuarter(record.point, box) < i;
+				});
+			}
+		}
+
+		// the node keeps points of the quarters while it has room for all of them, like QuadTree::Build
+		std::array<bool, Cardinals::COUNT> kept;
+		size_t size{ 0 };
+		for (size_t i = 0; i < Cardinals::COUNT; i++) {
+			const auto count = static_cast<size_t>(bounds[i + 1] - bounds[i]);
+			kept[i] = size + count <= MAX_POINTS;
+			if (kept[i]) {
+				size += count;
+			}
+		}
+
+		const auto index = m_nodeCount++;
+		const auto firstPoint = m_pointCount;
+		m_pointCount += size;
+		if (m_nodes) {
+			m_nodes[index].Assign(
+				box, Point{ 0, 0 }, static_cast<uint32_t>(firstPoint), static_cast<uint32_t>(size), 0, Division::MIDDLE
+			);
+		}
+		auto point = firstPoint;
+		for (size_t i = 0; i < Cardinals::COUNT; i++) {
+			if (kept[i]) {
+				WritePoints(bounds[i], bounds[i + 1], point);
+				point += static_cast<uint64_t>(bounds[i + 1] - bounds[i]);
+			}
+		}
+
+		for (size_t i = 0; i < Cardinals::COUNT; i++) {
+			if (kept[i]) {
+				continue;
+			}
+			const Rect childBox = GetRect(static_cast<Cardinals>(i), box);
+			// like `Insert` skip points which are lost by rounding of the quarter's boundary
+			const auto inside = KeepInside(bounds[i], bounds[i + 1], childBox);
+			if (m_nodes) {
+				m_nodes[index].m_children[i] = static_cast<uint32_t>(m_nodeCount);
+			}
+			size += Layout(bounds[i], inside, childBox, level + 1);
+		}
+		if (m_nodes) {
+			m_nodes[index].m_count = static_cast<uint32_t>(size);
+		}
+		return size;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	size_t FlatTreeBuilder<Payload, Coord, LeafCapacity>::LayoutOverflow(Record* first, Record* last, const Rect& box) {
+		// each leaf of the chain keeps the next points and is followed by its only child, like QuadTree::Build
+		for (auto it = first; ; ) {
+			const auto kept = it + std::min(static_cast<size_t>(last - it), MAX_POINTS);
+			const auto index = m_nodeCount++;
+			const auto firstPoint = m_pointCount;
+			m_pointCount += static_cast<uint64_t>(kept - it);
+			if (m_nodes) {
+				m_nodes[index].Assign(
+					box, Point{ 0, 0 }, static_cast<uint32_t>(firstPoint),
+					static_cast<uint32_t>(kept - it), static_cast<uint32_t>(last - it),
+					kept == last ? Division::MIDDLE : Division::NONE
+				);
+				if (kept != last) {
+					m_nodes[index].m_children[Cardinals::NW] = static_cast<uint32_t>(m_nodeCount);
+				}
+			}
+			WritePoints(it, kept, firstPoint);
+			if (kept == last) {
+				break;
+			}
+			it = kept;
+		}
+		return static_cast<size_t>(last - first);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void FlatTreeBuilder<Payload, Coord, LeafCapacity>::WritePoints(const Record* first, const Record* last, uint64_t index) {
+		const auto end = index + static_cast<uint64_t>(last - first);
+		if (m_nodes) {
+			for (auto it = first; it != last; it++, index++) {
+				m_xs[index] = it->point.x;
+				m_ys[index] = it->point.y;
+				if constexpr (Flat::HAS_PAYLOAD) {
+					m_values[index] = it->value;
+				}
+			}
+		}
+		if (end / (1 << 20) != (end - static_cast<uint64_t>(last - first)) / (1 << 20)) {
+			Report(m_nodes ? BuildStage::WRITE : BuildStage::LAYOUT, end, m_totalPoints);
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto FlatTreeBuilder<Payload, Coord, LeafCapacity>::KeepInside(Record* first, Record* last, const Rect& box) -> Record* {
+		const auto isOutside = [&box](const Record& record) {
+			return !box.Contains(record.point);
+		};
+		// the lost points are rare: the range is usually only scanned
+		auto out = std::find_if(first, last, isOutside);
+		if (out == last) {
+			return last;
+		}
+		std::vector<Record> outside;
+		for (auto it = out; it != last; it++) {
+			if (isOutside(*it)) {
+				outside.push_back(*it);
+			}
+			else {
+				*out++ = *it;
+			}
+		}
+		std::copy(outside.begin(), outside.end(), out);
+		return out;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	std::string FlatTreeBuilder<Payload, Coord, LeafCapacity>::MakeTempPath(const char* kind) {
+		return m_tempPrefix + "_" + kind + "_" + std::to_string(m_tempFiles++) + ".tmp";
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void FlatTreeBuilder<Payload, Coord, LeafCapacity>::Report(BuildStage stage, uint64_t done, uint64_t total) const {
+		if (m_options.progress) {
+			m_options.progress({ stage, done, total });
+		}
+	}
+
+} // namespace tree
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cassert>
+#include <type_traits>
+
+namespace tree {
+
+	/**
+	 * Stack keeping the first `N` items in the object itself.
+	 * Only the items pushed above `N` go to the heap, so traversal of the tree
+	 * which is not deeper than the inline capacity doesn't allocate.
+	 */
+	template<class T, size_t N>
+	class InlineStack {
+		static_assert(std::is_trivially_copyable_v<T>, "Stack is meant for pointers and indices");
+
+	public:
+		bool IsEmpty() const noexcept {
+			return m_size == 0;
+		}
+
+		size_t GetSize() const noexcept {
+			return m_size;
+		}
+
+		void Push(T value) {
+			if (m_size < N) {
+				m_inline[m_size] = value;
+			}
+			else {
+				m_overflow.push_back(value);
+			}
+			m_size++;
+		}
+
+		T Pop() {
+			assert(m_size > 0 && "Stack is empty");
+			m_size--;
+			if (m_size < N) {
+				return m_inline[m_size];
+			}
+			const T value = m_overflow.back();
+			m_overflow.pop_back();
+			return value;
+		}
+
+	private:
+		std::array<T, N> m_inline;
+		std::vector<T> m_overflow;
+		size_t m_size{ 0 };
+	};
+
+} // namespace tree
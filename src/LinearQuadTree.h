@@ -0,0 +1,762 @@
+#pragma once
+
+#include "healthy.h"
+#include "Cardinals.h"
+#include "Morton.h"
+#include "InlineStack.h"
+#include "Simd.h"
+#include "QuadTree.h"
+#include <array>
+#include <vector>
+#include <functional>
+#include <optional>
+#include <memory_resource>
+#include <queue>
+#include <iterator>
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+#include <limits>
+#include <utility>
+
+namespace tree {
+
+	/**
+	 * Pointer-free quad tree which keeps all of nodes in one contiguous array.
+	 *
+	 * Nodes refer to each other by 32-bit indices: four children of a node are allocated
+	 * together as a block of consecutive nodes, so a node keeps only the index of the first child.
+	 * Points are kept only in leaves. Each leaf owns a block of `MAX_POINTS` slots
+	 * in the point buffers shared by the whole tree (coordinates are kept in separate arrays
+	 * to be scanned by SIMD kernels), the empty leaf has no block at all.
+	 * Released blocks of nodes and points are recycled, so splits and merges don't allocate
+	 * once the buffers have grown.
+	 * Like in QuadTree the full leaf at the maximum depth or with too small box becomes an overflow leaf:
+	 * it keeps its points and passes the rest to its first child with the same box.
+	 *
+	 * @note it has the same operations as tree::QuadTree except handles and statistics of subtrees,
+	 * but the shape of the tree is different: the leaf is split into four quarters at once.
+	 */
+	template<class Payload = NoPayload, class Coord = float, size_t LeafCapacity = DEFAULT_LEAF_CAPACITY>
+	class LinearQuadTree {
+		static_assert(std::is_arithmetic_v<Coord>, "Coordinates must be of arithmetic type");
+		static_assert(LeafCapacity > 0, "Node must be able to keep at least one point");
+
+	public:
+		using Index = uint32_t;
+		using Point = mt::BasicPt<Coord>;
+		using Rect = mt::BasicRect<Coord>;
+
+		static constexpr Index NONE{ std::numeric_limits<Index>::max() };
+		static constexpr size_t MAX_POINTS{ LeafCapacity };
+		// number of nodes the traversal keeps without allocation
+		static constexpr size_t INLINE_STACK_SIZE{ 128 };
+
+		struct Node {
+			Rect m_box{ {0, 0}, {0, 0} };
+			// children are [m_firstChild, m_firstChild + Cardinals::COUNT) or NONE for the leaf
+			Index m_firstChild{ NONE };
+			// points of the node are [m_firstPoint, m_firstPoint + m_size) in the point buffers
+			Index m_firstPoint{ NONE };
+			uint32_t m_size{ 0 };
+			// Division::NONE for the overflow leaf: only its first child is used
+			Division m_division{ Division::MIDDLE };
+
+			bool IsLeaf() const noexcept {
+				return m_firstChild == NONE;
+			}
+		};
+
+		using Visitor_t = std::function<void(const Node&)>;
+
+		// nodes and points are allocated from the memory resource
+		explicit LinearQuadTree(const Rect& fullArea, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+		/**
+		 * Insert all of points into the tree.
+		 * Points are inserted to the empty tree in Morton order,
+		 * so the nodes of the same subtree are allocated close to each other.
+		 */
+		void Build(const std::vector<Point>& points);
+
+		// return all of points in the area
+		std::vector<Point> GetPointsAt(const Rect& area) const;
+
+		// write all of points in the area to `out` and return the end of the output
+		template<class OutputIt>
+		OutputIt GetPointsAt(const Rect& area, OutputIt out) const;
+
+		/**
+		 * Call `visitor(point, value)` for each point in the area.
+		 * The visitor may return false to stop the traversal early.
+		 * Return false if the traversal was stopped by the visitor.
+		 */
+		template<class Visitor>
+		bool ForEachAt(const Rect& area, Visitor&& visitor) const;
+
+		// return the closest neighbour point or nullopt if no points present
+		std::optional<Point> FindClosest(const Point& point) const;
+
+		// return up to `k` points closest to the `point` ordered by distance (closest first)
+		std::vector<Point> FindKClosest(const Point& point, size_t k) const;
+
+		// return all of points which are not farther than `radius` from the `point`
+		std::vector<Point> FindWithinRadius(const Point& point, Coord radius) const;
+
+		/**
+		 * Insert the point with the value unless the point is already in the tree.
+		 * Return whether the point was inserted.
+		 */
+		bool Insert(const Point& point, Payload value = {});
+
+		bool Contains(const Point& point) const;
+
+		// return the value stored with the point or nullptr if there is no such point
+		const Payload* Find(const Point& point) const;
+
+		Payload* Find(const Point& point);
+
+		/**
+		* Erase point from the tree.
+		* On successfull erasure trying to merge the quarters of the parent node back into single leaf
+		* Return whether the point was erased.
+		*/
+		bool Erase(const Point& point);
+
+		void PostOrderVisit(const Visitor_t& func) const;
+
+		void PreOrderVisit(const Visitor_t& func) const;
+
+		// return i-th point of the node; the node must belong to this tree
+		Point GetPoint(const Node& node, size_t index) const noexcept;
+
+		const Payload& GetValue(const Node& node, size_t index) const noexcept;
+
+		bool IsEmpty() const noexcept;
+
+		// retrun number of points in the tree
+		size_t GetSize() const noexcept;
+
+		// return number of allocated (used or recycled) nodes
+		size_t GetCapacity() const noexcept;
+
+		// remove all of points keeping the memory of the buffers
+		void Clear();
+
+		// set the depth of the nodes which aren't divided anymore (see QuadTree::SetSplitPolicy)
+		void SetMaxDepth(size_t maxDepth) noexcept;
+
+		size_t GetMaxDepth() const noexcept;
+
+		// set the minimum size of the quarters (see QuadTree::SetMinCellSize)
+		void SetMinCellSize(Coord size) noexcept;
+
+		Coord GetMinCellSize() const noexcept;
+
+	private:
+		using Path = InlineStack<Index, INLINE_STACK_SIZE>;
+
+		// the point of the input in Morton order
+		struct MortonItem {
+			uint64_t code;
+			uint32_t index;
+		};
+
+		// the node visited depth-first and the next of its children
+		struct VisitFrame {
+			Index node;
+			Index next;
+		};
+
+		// number of used children: the overflow leaf has only the first one
+		static Index GetChildCount(const Node& node) noexcept;
+
+		// return the child of the node on the way to the point
+		static Index GetChild(const Node& node, const Point& point) noexcept;
+
+		// return index of the point in the node or `m_size` if the node doesn't have it
+		size_t FindIn(const Node& node, const Point& point) const noexcept;
+
+		/**
+		 * Return the node which keeps the point and the index of the point in it, NONE if there is no such point.
+		 * The ancestors of the node are pushed to the path when it's given.
+		 */
+		std::pair<Index, size_t> Lookup(const Point& point, Path* path) const;
+
+		// return index of the first node of the block of four nodes
+		Index AllocateChildren();
+
+		// return index of the first slot of the block of MAX_POINTS points
+		Index AllocatePoints();
+
+		// give the block of the node's points back
+		void ReleasePoints(Node& node);
+
+		// append the point to the node which has its block of points and room for it
+		void Push(Node& node, const Point& point, Payload&& value);
+
+		// remove i-th point of the node moving the last one in its place
+		void Remove(Node& node, size_t index);
+
+		// split the full leaf at the depth into four quarters distributing its points between them
+		void Split(Index index, size_t depth);
+
+		// merge quarters of the node into it if they are leaves and can accomodate all of points
+		bool TryMerge(Index index);
+
+	private:
+		static constexpr Index ROOT{ 0 };
+
+		std::pmr::vector<Node> m_nodes;
+		std::pmr::vector<Coord> m_xs;
+		std::pmr::vector<Coord> m_ys;
+		std::pmr::vector<Payload> m_values;
+		// released blocks which can be reused
+		std::pmr::vector<Index> m_freeNodes;
+		std::pmr::vector<Index> m_freePoints;
+		// number of vertices in the tree
+		size_t m_size{ 0 };
+
+		size_t m_maxDepth{ DEFAULT_MAX_DEPTH };
+		Coord m_minCellSize{ 0 };
+	};
+
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	LinearQuadTree<Payload, Coord, LeafCapacity>::LinearQuadTree(const Rect& fullArea, std::pmr::memory_resource* resource)
+		: m_nodes{ resource }
+		, m_xs{ resource }
+		, m_ys{ resource }
+		, m_values{ resource }
+		, m_freeNodes{ resource }
+		, m_freePoints{ resource }
+	{
+		m_nodes.emplace_back();
+		m_nodes[ROOT].m_box = fullArea;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void LinearQuadTree<Payload, Coord, LeafCapacity>::Clear() {
+		// clean up everything except the root
+		const auto fullArea = m_nodes[ROOT].m_box;
+		m_nodes.clear();
+		m_xs.clear();
+		m_ys.clear();
+		m_values.clear();
+		m_freeNodes.clear();
+		m_freePoints.clear();
+
+		m_nodes.emplace_back();
+		m_nodes[ROOT].m_box = fullArea;
+		m_size = 0;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void LinearQuadTree<Payload, Coord, LeafCapacity>::Build(const std::vector<Point>& points) {
+		if (!IsEmpty()) {
+			for (const auto& point : points) {
+				Insert(point);
+			}
+			return;
+		}
+		assert(points.size() < std::numeric_limits<uint32_t>::max() && "Too many points");
+
+		const auto& fullArea = m_nodes[ROOT].m_box;
+		std::vector<MortonItem> sorted;
+		sorted.reserve(points.size());
+		for (size_t i = 0; i < points.size(); i++) {
+			if (fullArea.Contains(points[i])) {
+				sorted.push_back({ GetMortonCode(points[i], fullArea), static_cast<uint32_t>(i) });
+			}
+		}
+		RadixSort(sorted);
+
+		for (const auto& item : sorted) {
+			Insert(points[item.index]);
+		}
+	}
+
+	// return all of points in the area
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto LinearQuadTree<Payload, Coord, LeafCapacity>::GetPointsAt(const Rect& area) const -> std::vector<Point> {
+		std::vector<Point> points;
+		GetPointsAt(area, std::back_inserter(points));
+		return points;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	template<class OutputIt>
+	OutputIt LinearQuadTree<Payload, Coord, LeafCapacity>::GetPointsAt(const Rect& area, OutputIt out) const {
+		ForEachAt(area, [&out](const Point& point, const Payload&) {
+			*out++ = point;
+		});
+		return out;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	template<class Visitor>
+	bool LinearQuadTree<Payload, Coord, LeafCapacity>::ForEachAt(const Rect& area, Visitor&& visitor) const {
+		if (!m_nodes[ROOT].m_box.Intersect(area)) {
+			return true;
+		}
+
+		Path processed;
+		processed.Push(ROOT);
+		std::array<uint32_t, MAX_POINTS> found;
+
+		while (!processed.IsEmpty()) {
+			const auto& current = m_nodes[processed.Pop()];
+
+			if (current.m_size > 0) {
+				const size_t first = current.m_firstPoint;
+				const size_t count = simd::FindInRect(m_xs.data() + first, m_ys.data() + first, current.m_size, area, found.data());
+				for (size_t i = 0; i < count; i++) {
+					const size_t slot = first + found[i];
+					if (!detail::Visit(visitor, Point{ m_xs[slot], m_ys[slot] }, m_values[slot])) {
+						return false;
+					}
+				}
+			}
+
+			if (current.IsLeaf()) {
+				continue;
+			}
+			for (Index quarter = current.m_firstChild; quarter < current.m_firstChild + GetChildCount(current); quarter++) {
+				if (m_nodes[quarter].m_box.Intersect(area)) {
+					processed.Push(quarter);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	// return the closest neighbour point or nullopt if no points present
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto LinearQuadTree<Payload, Coord, LeafCapacity>::FindClosest(const Point& point) const -> std::optional<Point> {
+		if (auto closest = FindKClosest(point, 1); !closest.empty()) {
+			return closest.front();
+		}
+		return std::nullopt;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto LinearQuadTree<Payload, Coord, LeafCapacity>::FindKClosest(const Point& point, size_t k) const -> std::vector<Point> {
+		std::vector<Point> closest;
+		if (k == 0 || IsEmpty()) {
+			return closest;
+		}
+		closest.reserve(std::min(k, m_size));
+
+		// either a node or a point (when `node` is NONE)
+		struct Candidate {
+			SquareDistance_t<Coord> distance;
+			Index node;
+			Point point;
+		};
+		const auto isFarther = [](const Candidate& lhs, const Candidate& rhs) {
+			return lhs.distance > rhs.distance;
+		};
+		std::priority_queue<Candidate, std::vector<Candidate>, decltype(isFarther)> candidates{ isFarther };
+		candidates.push({ GetSquareDistance(m_nodes[ROOT].m_box, point), ROOT, {} });
+
+		while (!candidates.empty() && closest.size() < k) {
+			const auto current = candidates.top();
+			candidates.pop();
+
+			if (current.node == NONE) {
+				closest.push_back(current.point);
+				continue;
+			}
+
+			const auto& node = m_nodes[current.node];
+			for (size_t i = 0; i < node.m_size; i++) {
+				const auto data = GetPoint(node, i);
+				candidates.push({ GetSquareDistance(data, point), NONE, data });
+			}
+
+			if (node.IsLeaf()) {
+				continue;
+			}
+			for (Index quarter = node.m_firstChild; quarter < node.m_firstChild + GetChildCount(node); quarter++) {
+				// empty leaves have nothing to offer
+				if (!m_nodes[quarter].IsLeaf() || m_nodes[quarter].m_size > 0) {
+					candidates.push({ GetSquareDistance(m_nodes[quarter].m_box, point), quarter, {} });
+				}
+			}
+		}
+
+		return closest;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto LinearQuadTree<Payload, Coord, LeafCapacity>::FindWithinRadius(const Point& point, Coord radius) const -> std::vector<Point> {
+		std::vector<Point> points;
+		if (radius < Coord(0)) {
+			return points;
+		}
+		const auto squareRadius = static_cast<SquareDistance_t<Coord>>(radius) * static_cast<SquareDistance_t<Coord>>(radius);
+
+		Path processed;
+		processed.Push(ROOT);
+		std::array<uint32_t, MAX_POINTS> found;
+
+		while (!processed.IsEmpty()) {
+			const auto& current = m_nodes[processed.Pop()];
+
+			if (current.m_size > 0) {
+				const size_t first = current.m_firstPoint;
+				const size_t count = simd::FindInCircle(
+					m_xs.data() + first, m_ys.data() + first, current.m_size, point, squareRadius, found.data()
+				);
+				for (size_t i = 0; i < count; i++) {
+					points.push_back({ m_xs[first + found[i]], m_ys[first + found[i]] });
+				}
+			}
+
+			if (current.IsLeaf()) {
+				continue;
+			}
+			// skip whole quarters which are too far away
+			for (Index quarter = current.m_firstChild; quarter < current.m_firstChild + GetChildCount(current); quarter++) {
+				if (GetSquareDistance(m_nodes[quarter].m_box, point) <= squareRadius) {
+					processed.Push(quarter);
+				}
+			}
+		}
+
+		return points;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool LinearQuadTree<Payload, Coord, LeafCapacity>::Insert(const Point& point, Payload value) {
+		// point is outside the boundary
+		if (!m_nodes[ROOT].m_box.Contains(point)) {
+			return false;
+		}
+
+		Index index = ROOT;
+		size_t depth{ 0 };
+		while (true) {
+			const auto& node = m_nodes[index];
+			if (FindIn(node, point) < node.m_size) {
+				// point already exist in the tree
+				return false;
+			}
+			// the overflow leaf which has a child passes the points to it even if some of its own were erased
+			if (!node.IsLeaf()) {
+				index = GetChild(node, point);
+				depth++;
+				continue;
+			}
+			if (node.m_size < MAX_POINTS) {
+				if (node.m_firstPoint == NONE) {
+					const auto first = AllocatePoints();
+					// allocation of points doesn't touch nodes
+					m_nodes[index].m_firstPoint = first;
+				}
+				Push(m_nodes[index], point, std::move(value));
+				m_size++;
+				return true;
+			}
+			Split(index, depth);
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool LinearQuadTree<Payload, Coord, LeafCapacity>::Contains(const Point& point) const {
+		return Lookup(point, nullptr).first != NONE;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	const Payload* LinearQuadTree<Payload, Coord, LeafCapacity>::Find(const Point& point) const {
+		const auto [index, slot] = Lookup(point, nullptr);
+		return index == NONE ? nullptr : &m_values[m_nodes[index].m_firstPoint + slot];
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	Payload* LinearQuadTree<Payload, Coord, LeafCapacity>::Find(const Point& point) {
+		return const_cast<Payload*>(std::as_const(*this).Find(point));
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool LinearQuadTree<Payload, Coord, LeafCapacity>::Erase(const Point& point) {
+		// remember the path to restore properties of the tree on the way back
+		Path path;
+		const auto [index, slot] = Lookup(point, &path);
+		if (index == NONE) {
+			return false;
+		}
+
+		auto& node = m_nodes[index];
+		Remove(node, slot);
+		m_size--;
+		if (node.m_size == 0) {
+			ReleasePoints(node);
+		}
+		// the overflow leaf may take the points of its child now
+		if (!node.IsLeaf()) {
+			path.Push(index);
+		}
+
+		while (!path.IsEmpty() && TryMerge(path.Pop())) {
+		}
+		return true;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void LinearQuadTree<Payload, Coord, LeafCapacity>::PostOrderVisit(const Visitor_t& func) const {
+		InlineStack<VisitFrame, INLINE_STACK_SIZE> frames;
+		frames.Push({ ROOT, 0 });
+		while (!frames.IsEmpty()) {
+			const auto frame = frames.Pop();
+			const auto& node = m_nodes[frame.node];
+			if (!node.IsLeaf() && frame.next < GetChildCount(node)) {
+				// come back to the node after its child
+				frames.Push({ frame.node, frame.next + 1 });
+				frames.Push({ node.m_firstChild + frame.next, 0 });
+				continue;
+			}
+			std::invoke(func, node);
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void LinearQuadTree<Payload, Coord, LeafCapacity>::PreOrderVisit(const Visitor_t& func) const {
+		Path processed;
+		processed.Push(ROOT);
+		while (!processed.IsEmpty()) {
+			const auto& node = m_nodes[processed.Pop()];
+			std::invoke(func, node);
+			if (node.IsLeaf()) {
+				continue;
+			}
+			// the first child is visited first
+			for (Index quarter = node.m_firstChild + GetChildCount(node); quarter-- > node.m_firstChild; ) {
+				processed.Push(quarter);
+			}
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto LinearQuadTree<Payload, Coord, LeafCapacity>::GetPoint(const Node& node, size_t index) const noexcept -> Point {
+		assert(index < node.m_size && "Point is out of the node");
+		return { m_xs[node.m_firstPoint + index], m_ys[node.m_firstPoint + index] };
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	const Payload& LinearQuadTree<Payload, Coord, LeafCapacity>::GetValue(const Node& node, size_t index) const noexcept {
+		assert(index < node.m_size && "Point is out of the node");
+		return m_values[node.m_firstPoint + index];
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool LinearQuadTree<Payload, Coord, LeafCapacity>::IsEmpty() const noexcept {
+		return m_size == 0;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	size_t LinearQuadTree<Payload, Coord, LeafCapacity>::GetSize() const noexcept {
+		return m_size;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	size_t LinearQuadTree<Payload, Coord, LeafCapacity>::GetCapacity() const noexcept {
+		return m_nodes.size();
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void LinearQuadTree<Payload, Coord, LeafCapacity>::SetMaxDepth(size_t maxDepth) noexcept {
+		m_maxDepth = maxDepth;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	size_t LinearQuadTree<Payload, Coord, LeafCapacity>::GetMaxDepth() const noexcept {
+		return m_maxDepth;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void LinearQuadTree<Payload, Coord, LeafCapacity>::SetMinCellSize(Coord size) noexcept {
+		m_minCellSize = size;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	Coord LinearQuadTree<Payload, Coord, LeafCapacity>::GetMinCellSize() const noexcept {
+		return m_minCellSize;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto LinearQuadTree<Payload, Coord, LeafCapacity>::GetChildCount(const Node& node) noexcept -> Index {
+		return node.m_division == Division::NONE ? 1 : static_cast<Index>(Cardinals::COUNT);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto LinearQuadTree<Payload, Coord, LeafCapacity>::GetChild(const Node& node, const Point& point) noexcept -> Index {
+		return node.m_division == Division::NONE ? node.m_firstChild : node.m_firstChild + GetQuarter(point, node.m_box);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	size_t LinearQuadTree<Payload, Coord, LeafCapacity>::FindIn(const Node& node, const Point& point) const noexcept {
+		size_t i{ 0 };
+		for (const size_t first = node.m_firstPoint; i < node.m_size; i++) {
+			if (m_xs[first + i] == point.x && m_ys[first + i] == point.y) {
+				break;
+			}
+		}
+		return i;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto LinearQuadTree<Payload, Coord, LeafCapacity>::Lookup(const Point& point, Path* path) const -> std::pair<Index, size_t> {
+		// point is outside the boundary
+		if (!m_nodes[ROOT].m_box.Contains(point)) {
+			return { NONE, 0 };
+		}
+
+		Index index = ROOT;
+		while (true) {
+			const auto& node = m_nodes[index];
+			if (const auto slot = FindIn(node, point); slot < node.m_size) {
+				return { index, slot };
+			}
+			if (node.IsLeaf()) {
+				return { NONE, 0 };
+			}
+			if (path) {
+				path->Push(index);
+			}
+			index = GetChild(node, point);
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto LinearQuadTree<Payload, Coord, LeafCapacity>::AllocateChildren() -> Index {
+		if (!m_freeNodes.empty()) {
+			const auto first = m_freeNodes.back();
+			m_freeNodes.pop_back();
+			return first;
+		}
+		assert(m_nodes.size() + Cardinals::COUNT < NONE && "Run out of node indices");
+		const auto first = static_cast<Index>(m_nodes.size());
+		m_nodes.resize(m_nodes.size() + Cardinals::COUNT);
+		return first;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto LinearQuadTree<Payload, Coord, LeafCapacity>::AllocatePoints() -> Index {
+		if (!m_freePoints.empty()) {
+			const auto first = m_freePoints.back();
+			m_freePoints.pop_back();
+			return first;
+		}
+		assert(m_xs.size() + MAX_POINTS < NONE && "Run out of point indices");
+		const auto first = static_cast<Index>(m_xs.size());
+		m_xs.resize(m_xs.size() + MAX_POINTS);
+		m_ys.resize(m_ys.size() + MAX_POINTS);
+		m_values.resize(m_values.size() + MAX_POINTS);
+		return first;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void LinearQuadTree<Payload, Coord, LeafCapacity>::ReleasePoints(Node& node) {
+		if (node.m_firstPoint != NONE) {
+			assert(node.m_size == 0 && "Points of the node are lost");
+			m_freePoints.push_back(node.m_firstPoint);
+			node.m_firstPoint = NONE;
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void LinearQuadTree<Payload, Coord, LeafCapacity>::Push(Node& node, const Point& point, Payload&& value) {
+		assert(node.m_firstPoint != NONE && node.m_size < MAX_POINTS && "Node has no room for the point");
+		const size_t slot = node.m_firstPoint + node.m_size++;
+		m_xs[slot] = point.x;
+		m_ys[slot] = point.y;
+		m_values[slot] = std::move(value);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void LinearQuadTree<Payload, Coord, LeafCapacity>::Remove(Node& node, size_t index) {
+		const size_t slot = node.m_firstPoint + index;
+		const size_t last = node.m_firstPoint + --node.m_size;
+		if (slot != last) {
+			m_xs[slot] = m_xs[last];
+			m_ys[slot] = m_ys[last];
+			m_values[slot] = std::move(m_values[last]);
+		}
+		if constexpr (!std::is_trivially_destructible_v<Payload>) {
+			// the value isn't kept alive by the free slot
+			m_values[last] = Payload{};
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void LinearQuadTree<Payload, Coord, LeafCapacity>::Split(Index index, size_t depth) {
+		assert(m_nodes[index].IsLeaf() && "Trying to split non-leaf node");
+
+		const bool divisible = depth < m_maxDepth && IsDivisible(m_nodes[index].m_box, m_minCellSize);
+		// allocation may invalidate references to the nodes
+		const Index first = AllocateChildren();
+		auto& node = m_nodes[index];
+		for (size_t i = 0; i < Cardinals::COUNT; i++) {
+			auto& child = m_nodes[first + i];
+			child = Node{};
+			child.m_box = divisible ? GetRect(static_cast<Cardinals>(i), node.m_box) : node.m_box;
+		}
+		node.m_firstChild = first;
+		node.m_division = divisible ? Division::MIDDLE : Division::NONE;
+		if (!divisible) {
+			// the overflow leaf keeps its points
+			return;
+		}
+
+		for (size_t i = 0; i < node.m_size; i++) {
+			const size_t slot = node.m_firstPoint + i;
+			const Point point{ m_xs[slot], m_ys[slot] };
+			auto& child = m_nodes[first + GetQuarter(point, node.m_box)];
+			if (child.m_firstPoint == NONE) {
+				child.m_firstPoint = AllocatePoints();
+			}
+			Push(child, point, std::move(m_values[slot]));
+		}
+		node.m_size = 0;
+		ReleasePoints(node);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool LinearQuadTree<Payload, Coord, LeafCapacity>::TryMerge(Index index) {
+		auto& node = m_nodes[index];
+		assert(!node.IsLeaf() && "Trying to merge leaf node");
+
+		size_t total{ node.m_size };
+		for (Index quarter = node.m_firstChild; quarter < node.m_firstChild + GetChildCount(node); quarter++) {
+			if (!m_nodes[quarter].IsLeaf()) {
+				return false;
+			}
+			total += m_nodes[quarter].m_size;
+		}
+		if (total > MAX_POINTS) {
+			return false;
+		}
+
+		if (total > 0 && node.m_firstPoint == NONE) {
+			// allocation of points doesn't touch nodes so the reference is still valid
+			node.m_firstPoint = AllocatePoints();
+		}
+		for (Index quarter = node.m_firstChild; quarter < node.m_firstChild + GetChildCount(node); quarter++) {
+			auto& child = m_nodes[quarter];
+			for (size_t i = 0; i < child.m_size; i++) {
+				const size_t slot = child.m_firstPoint + i;
+				Push(node, { m_xs[slot], m_ys[slot] }, std::move(m_values[slot]));
+			}
+			child.m_size = 0;
+			ReleasePoints(child);
+		}
+		m_freeNodes.push_back(node.m_firstChild);
+		node.m_firstChild = NONE;
+		node.m_division = Division::MIDDLE;
+		return true;
+	}
+
+} // namespace tree
@@ -0,0 +1,259 @@
+#pragma once
+
+#include "healthy.h"
+#include "Cardinals.h"
+#include <memory_resource>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <algorithm>
+
+namespace tree {
+
+	/**
+	 * Locational code of the node of the regular subdivision (the box divided at the middle down from the root):
+	 * the leading one bit followed by the quarters (see tree::Cardinals) of the path from the root, two bits per level.
+	 * The bits of the quarters interleave the column (even bits) and the row (odd bits) of the cell
+	 * at the node's depth, so the codes of the neighbouring cells are found without the tree.
+	 */
+	constexpr uint64_t ROOT_CODE{ 1 };
+
+	// the deepest level which code fits 64 bits
+	constexpr size_t MAX_CODE_DEPTH{ 31 };
+
+	constexpr uint64_t GetChildCode(uint64_t code, Cardinals cardinal) noexcept {
+		return (code << 2) | static_cast<uint64_t>(cardinal);
+	}
+
+	// return depth of the node with the code (the root is at zero)
+	constexpr size_t GetCodeDepth(uint64_t code) noexcept {
+		assert(code != 0 && "Code of the node has the leading bit");
+		size_t depth{ 0 };
+		for (; code > ROOT_CODE; code >>= 2) {
+			depth++;
+		}
+		return depth;
+	}
+
+	// spread the lower 32 bits of the value to the even bits
+	constexpr uint64_t SpreadBits(uint64_t value) noexcept {
+		value &= 0xFFFF'FFFF;
+		value = (value | (value << 16)) & 0x0000'FFFF'0000'FFFF;
+		value = (value | (value << 8)) & 0x00FF'00FF'00FF'00FF;
+		value = (value | (value << 4)) & 0x0F0F'0F0F'0F0F'0F0F;
+		value = (value | (value << 2)) & 0x3333'3333'3333'3333;
+		value = (value | (value << 1)) & 0x5555'5555'5555'5555;
+		return value;
+	}
+
+	/**
+	 * Return code of the cell at MAX_CODE_DEPTH which has the point, the codes of the larger cells
+	 * on the way to it are its prefixes. The column and the row are computed at once from the position
+	 * of the point in the box, so near the boundaries of the cells they may differ from the quarters
+	 * chosen by the subdivision of the box by rounding errors (see QuadTree::FindIndexed).
+	 */
+	template<class Coord>
+	uint64_t GetCellCode(const mt::BasicPt<Coord>& point, const mt::BasicRect<Coord>& box) noexcept {
+		constexpr uint64_t CELLS{ uint64_t{ 1 } << MAX_CODE_DEPTH };
+		const auto cell = [](double offset, double size) -> uint64_t {
+			const double position = offset / size * static_cast<double>(CELLS);
+			// NaN of the empty box goes to the first cell
+			if (position >= static_cast<double>(CELLS)) {
+				return CELLS - 1;
+			}
+			return position > 0.0 ? static_cast<uint64_t>(position) : 0;
+		};
+		const uint64_t column = cell(
+			static_cast<double>(point.x) - static_cast<double>(box.GetMinX()), static_cast<double>(box.size.width)
+		);
+		const uint64_t row = cell(
+			static_cast<double>(point.y) - static_cast<double>(box.GetMinY()), static_cast<double>(box.size.height)
+		);
+		return (ROOT_CODE << (2 * MAX_CODE_DEPTH)) | SpreadBits(column) | (SpreadBits(row) << 1);
+	}
+
+	/**
+	 * Return code of the cell of the same depth beside the side of the cell or zero
+	 * if the cell is at that side of the root. The column (or the row) is incremented or decremented
+	 * in place: the bits of the other coordinate are set (or cleared) so the carry (or borrow) passes them.
+	 */
+	constexpr uint64_t GetNeighbourCode(uint64_t code, Side side) noexcept {
+		const size_t depth = GetCodeDepth(code);
+		const uint64_t leading = uint64_t{ 1 } << (2 * depth);
+		const uint64_t columns = 0x5555'5555'5555'5555 & (leading - 1);
+		const uint64_t rows = columns << 1;
+		const uint64_t mask = side == Side::WEST || side == Side::EAST ? columns : rows;
+		const uint64_t kept = code & ~mask;
+		const uint64_t coordinate = code & mask;
+		if (side == Side::EAST || side == Side::SOUTH) {
+			return coordinate == mask ? 0 : kept | (((coordinate | ~mask) + 1) & mask);
+		}
+		return coordinate == 0 ? 0 : kept | ((coordinate - 1) & mask);
+	}
+
+	/**
+	 * Hash map from the locational codes of the nodes to the nodes with open addressing (linear probing).
+	 * The slots are allocated from the memory resource and kept by `Clear`.
+	 * It also counts the codes of each depth, so the search over the depths knows where the deepest ones are.
+	 */
+	template<class Node>
+	class LocationIndex {
+	public:
+		explicit LocationIndex(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+		// add the node or replace the node of the same code
+		void Insert(uint64_t code, Node* node);
+
+		void Erase(uint64_t code) noexcept;
+
+		// return the node of the code or nullptr
+		Node* Find(uint64_t code) const noexcept;
+
+		void Clear() noexcept;
+
+		bool IsEmpty() const noexcept;
+
+		// return the depth of the deepest code in the index
+		size_t GetDepth() const noexcept;
+
+	private:
+		// the slot is free when its code is zero: codes of the nodes have the leading bit
+		struct Slot {
+			uint64_t m_code{ 0 };
+			Node* m_node{ nullptr };
+		};
+
+		static constexpr size_t MIN_CAPACITY{ 64 };
+
+		size_t GetHome(uint64_t code) const noexcept;
+
+		// double the capacity once the slots are half full
+		void Grow();
+
+	private:
+		// the capacity is a power of two
+		std::pmr::vector<Slot> m_slots;
+		// log2 of the capacity
+		size_t m_bits{ 0 };
+		size_t m_size{ 0 };
+		std::array<size_t, MAX_CODE_DEPTH + 1> m_depths{};
+	};
+
+	template<class Node>
+	LocationIndex<Node>::LocationIndex(std::pmr::memory_resource* resource)
+		: m_slots{ resource }
+	{
+	}
+
+	template<class Node>
+	void LocationIndex<Node>::Insert(uint64_t code, Node* node) {
+		assert(code != 0 && GetCodeDepth(code) <= MAX_CODE_DEPTH && "Code is out of range");
+		if (2 * (m_size + 1) > m_slots.size()) {
+			Grow();
+		}
+		const size_t mask = m_slots.size() - 1;
+		size_t index = GetHome(code);
+		while (m_slots[index].m_code != 0 && m_slots[index].m_code != code) {
+			index = (index + 1) & mask;
+		}
+		if (m_slots[index].m_code == 0) {
+			m_size++;
+			m_depths[GetCodeDepth(code)]++;
+		}
+		m_slots[index] = { code, node };
+	}
+
+	/**
+	 * Backward shift deletion: the following slots of the cluster which may be
+	 * moved closer to their home take the place of the erased one, so no tombstones are needed.
+	 */
+	template<class Node>
+	void LocationIndex<Node>::Erase(uint64_t code) noexcept {
+		if (m_size == 0) {
+			return;
+		}
+		const size_t mask = m_slots.size() - 1;
+		size_t index = GetHome(code);
+		while (m_slots[index].m_code != code) {
+			if (m_slots[index].m_code == 0) {
+				return;
+			}
+			index = (index + 1) & mask;
+		}
+		m_size--;
+		m_depths[GetCodeDepth(code)]--;
+		for (size_t next = (index + 1) & mask; m_slots[next].m_code != 0; next = (next + 1) & mask) {
+			// the slot may move to the hole if its home isn't between the hole and the slot
+			const size_t home = GetHome(m_slots[next].m_code);
+			if (((next - home) & mask) >= ((next - index) & mask)) {
+				m_slots[index] = m_slots[next];
+				index = next;
+			}
+		}
+		m_slots[index] = {};
+	}
+
+	template<class Node>
+	Node* LocationIndex<Node>::Find(uint64_t code) const noexcept {
+		if (m_size == 0) {
+			return nullptr;
+		}
+		const size_t mask = m_slots.size() - 1;
+		for (size_t index = GetHome(code); m_slots[index].m_code != 0; index = (index + 1) & mask) {
+			if (m_slots[index].m_code == code) {
+				return m_slots[index].m_node;
+			}
+		}
+		return nullptr;
+	}
+
+	template<class Node>
+	void LocationIndex<Node>::Clear() noexcept {
+		if (m_size > 0) {
+			std::fill(m_slots.begin(), m_slots.end(), Slot{});
+		}
+		m_size = 0;
+		m_depths.fill(0);
+	}
+
+	template<class Node>
+	bool LocationIndex<Node>::IsEmpty() const noexcept {
+		return m_size == 0;
+	}
+
+	template<class Node>
+	size_t LocationIndex<Node>::GetDepth() const noexcept {
+		size_t depth = MAX_CODE_DEPTH;
+		while (depth > 0 && m_depths[depth] == 0) {
+			depth--;
+		}
+		return depth;
+	}
+
+	template<class Node>
+	size_t LocationIndex<Node>::GetHome(uint64_t code) const noexcept {
+		// Fibonacci hashing: the high bits of the product depend on all bits of the code
+		constexpr uint64_t MULTIPLIER{ 0x9E37'79B9'7F4A'7C15 };
+		return static_cast<size_t>((code * MULTIPLIER) >> (64 - m_bits));
+	}
+
+	template<class Node>
+	void LocationIndex<Node>::Grow() {
+		std::pmr::vector<Slot> slots{ std::max(MIN_CAPACITY, 2 * m_slots.size()), Slot{}, m_slots.get_allocator() };
+		std::swap(slots, m_slots);
+		m_bits = 0;
+		while ((size_t{ 1 } << m_bits) < m_slots.size()) {
+			m_bits++;
+		}
+		m_size = 0;
+		m_depths.fill(0);
+		for (const auto& slot : slots) {
+			if (slot.m_code != 0) {
+				Insert(slot.m_code, slot.m_node);
+			}
+		}
+	}
+
+} // namespace tree
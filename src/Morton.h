@@ -0,0 +1,99 @@
+#pragma once
+
+#include "healthy.h"
+#include "Cardinals.h"
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <utility>
+
+namespace tree {
+
+	// number of levels of the tree encoded into 64-bit code: two bits per level
+	constexpr size_t MORTON_LEVELS{ 32 };
+
+	/**
+	 * Return Z-order (Morton) code of the point relative to the box.
+	 * Each level of subdivision contributes two bits (the quarter, see tree::Cardinals)
+	 * starting from the most significant ones. The code is computed by the same subdivision
+	 * the tree uses, so sorting by it gives exactly the order of pre-order traversal of the tree.
+	 */
+	template<class Coord>
+	uint64_t GetMortonCode(const mt::BasicPt<Coord>& point, mt::BasicRect<Coord> box) noexcept {
+		uint64_t code{ 0 };
+		for (size_t level = 0; level < MORTON_LEVELS; level++) {
+			const auto quarter = GetQuarter(point, box);
+			code = (code << 2) | static_cast<uint64_t>(quarter);
+			box = GetRect(quarter, box);
+		}
+		return code;
+	}
+
+	// return the quarter encoded in the code at the level (zero is the root level)
+	constexpr Cardinals GetQuarterAt(uint64_t code, size_t level) noexcept {
+		return static_cast<Cardinals>((code >> (2 * (MORTON_LEVELS - level - 1))) & 0b11);
+	}
+
+	/**
+	 * Sort items by the `code` member using LSD radix sort with 8-bit digits.
+	 * The digits which are the same for all of items are skipped.
+	 * The sort is stable.
+	 */
+	template<class Item>
+	void RadixSort(Item* first, Item* last) {
+		constexpr size_t DIGIT_BITS{ 8 };
+		constexpr size_t DIGITS{ sizeof(uint64_t) * 8 / DIGIT_BITS };
+		constexpr size_t BUCKETS{ 1 << DIGIT_BITS };
+		// it's cheaper to use comparison sort for the small input
+		constexpr size_t SMALL_INPUT{ 256 };
+
+		const auto size = static_cast<size_t>(last - first);
+		if (size <= SMALL_INPUT) {
+			std::stable_sort(first, last, [](const Item& lhs, const Item& rhs) {
+				return lhs.code < rhs.code;
+			});
+			return;
+		}
+
+		// count all of digits in one pass
+		std::vector<std::array<size_t, BUCKETS>> counts(DIGITS);
+		for (auto& digit : counts) {
+			digit.fill(0);
+		}
+		for (auto item = first; item != last; item++) {
+			for (size_t digit = 0; digit < DIGITS; digit++) {
+				counts[digit][(item->code >> (digit * DIGIT_BITS)) & (BUCKETS - 1)]++;
+			}
+		}
+
+		std::vector<Item> buffer(size);
+		Item* from = first;
+		Item* to = buffer.data();
+		for (size_t digit = 0; digit < DIGITS; digit++) {
+			auto& count = counts[digit];
+			if (std::any_of(count.cbegin(), count.cend(), [size](size_t n) { return n == size; })) {
+				// all of items have the same digit
+				continue;
+			}
+			// turn counts into offsets
+			size_t offset{ 0 };
+			for (auto& n : count) {
+				offset += std::exchange(n, offset);
+			}
+			for (auto item = from; item != from + size; item++) {
+				to[count[(item->code >> (digit * DIGIT_BITS)) & (BUCKETS - 1)]++] = *item;
+			}
+			std::swap(from, to);
+		}
+		if (from != first) {
+			std::copy(from, from + size, first);
+		}
+	}
+
+	template<class Item>
+	void RadixSort(std::vector<Item>& items) {
+		RadixSort(items.data(), items.data() + items.size());
+	}
+
+} // namespace tree
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <memory_resource>
+#include <mutex>
+#include <array>
+#include <new>
+#include <cstddef>
+#include <cassert>
+#include <algorithm>
+#include <type_traits>
+
+namespace tree {
+
+	/**
+	 * Storage of the tree's nodes.
+	 * Nodes are carved out of chunks allocated from the memory resource (bump allocation),
+	 * released nodes go to the free list and are reused first.
+	 * Chunks are kept until the pool is destroyed, so `Reset` makes all of memory reusable
+	 * without any call to the memory resource.
+	 */
+	template<class Node>
+	class NodePool {
+	public:
+		explicit NodePool(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) noexcept;
+
+		~NodePool();
+
+		NodePool(const NodePool&) = delete;
+		NodePool& operator=(const NodePool&) = delete;
+
+		// construct the node
+		Node* Acquire();
+
+		// destroy the node and recycle its memory
+		void Release(Node* node) noexcept;
+
+		/**
+		 * Forget all of nodes: the memory is reused by next acquisitions.
+		 * Destructors of the nodes are not called.
+		 */
+		void Reset() noexcept;
+
+		std::pmr::memory_resource* GetResource() const noexcept;
+
+		// number of nodes the chunks can accomodate
+		size_t GetCapacity() const noexcept;
+
+	private:
+		// memory of a node, it's a link of the free list while the node is released
+		union Block {
+			Block* m_next;
+			alignas(Node) unsigned char m_bytes[sizeof(Node)];
+		};
+
+		struct Chunk {
+			Chunk* m_next;
+			size_t m_size;
+
+			Block* GetBlocks() noexcept;
+		};
+
+		// blocks follow the header of the chunk
+		static constexpr size_t HEADER_SIZE{ (sizeof(Chunk) + alignof(Block) - 1) / alignof(Block) * alignof(Block) };
+		static constexpr size_t ALIGNMENT{ std::max(alignof(Chunk), alignof(Block)) };
+		static constexpr size_t FIRST_CHUNK_SIZE{ 16 };
+		static constexpr size_t MAX_CHUNK_SIZE{ 4096 };
+
+		void AddChunk();
+
+	private:
+		std::pmr::memory_resource* m_resource{ nullptr };
+		// chunks in order of allocation, `m_current` is the one used by bump allocation
+		Chunk* m_first{ nullptr };
+		Chunk* m_last{ nullptr };
+		Chunk* m_current{ nullptr };
+		size_t m_used{ 0 };
+		Block* m_free{ nullptr };
+		size_t m_capacity{ 0 };
+	};
+
+	/**
+	 * Nodes taken from the pool shared with other threads.
+	 * The nodes are acquired in batches under the lock, the unused ones are released on destruction.
+	 */
+	template<class Node>
+	class NodeBatch {
+	public:
+		NodeBatch(NodePool<Node>& pool, std::mutex& mutex) noexcept;
+
+		~NodeBatch();
+
+		NodeBatch(const NodeBatch&) = delete;
+		NodeBatch& operator=(const NodeBatch&) = delete;
+
+		Node* Acquire();
+
+	private:
+		static constexpr size_t BATCH_SIZE{ 64 };
+
+		NodePool<Node>& m_pool;
+		std::mutex& m_mutex;
+		std::array<Node*, BATCH_SIZE> m_nodes;
+		size_t m_size{ 0 };
+	};
+
+
+	template<class Node>
+	auto NodePool<Node>::Chunk::GetBlocks() noexcept -> Block* {
+		return reinterpret_cast<Block*>(reinterpret_cast<unsigned char*>(this) + HEADER_SIZE);
+	}
+
+	template<class Node>
+	NodePool<Node>::NodePool(std::pmr::memory_resource* resource) noexcept
+		: m_resource{ resource }
+	{
+		assert(m_resource && "Memory resource is required");
+	}
+
+	template<class Node>
+	NodePool<Node>::~NodePool() {
+		for (auto chunk = m_first; chunk != nullptr; ) {
+			const auto next = chunk->m_next;
+			m_resource->deallocate(chunk, HEADER_SIZE + chunk->m_size * sizeof(Block), ALIGNMENT);
+			chunk = next;
+		}
+	}
+
+	template<class Node>
+	Node* NodePool<Node>::Acquire() {
+		Block* block{ nullptr };
+		if (m_free != nullptr) {
+			block = m_free;
+			m_free = m_free->m_next;
+		}
+		else {
+			if (m_current == nullptr || m_used == m_current->m_size) {
+				if (m_current != nullptr && m_current->m_next != nullptr) {
+					// reuse the chunk left after reset
+					m_current = m_current->m_next;
+				}
+				else {
+					AddChunk();
+				}
+				m_used = 0;
+			}
+			block = m_current->GetBlocks() + m_used++;
+		}
+		return new (block->m_bytes) Node{};
+	}
+
+	template<class Node>
+	void NodePool<Node>::Release(Node* node) noexcept {
+		assert(node && "Can't release null node");
+		node->~Node();
+		auto block = reinterpret_cast<Block*>(node);
+		block->m_next = m_free;
+		m_free = block;
+	}
+
+	template<class Node>
+	void NodePool<Node>::Reset() noexcept {
+		m_current = m_first;
+		m_used = 0;
+		m_free = nullptr;
+	}
+
+	template<class Node>
+	std::pmr::memory_resource* NodePool<Node>::GetResource() const noexcept {
+		return m_resource;
+	}
+
+	template<class Node>
+	size_t NodePool<Node>::GetCapacity() const noexcept {
+		return m_capacity;
+	}
+
+	template<class Node>
+	void NodePool<Node>::AddChunk() {
+		// chunks grow with the tree
+		const size_t size = m_last == nullptr ? FIRST_CHUNK_SIZE : std::min(m_last->m_size * 2, MAX_CHUNK_SIZE);
+		auto chunk = static_cast<Chunk*>(m_resource->allocate(HEADER_SIZE + size * sizeof(Block), ALIGNMENT));
+		chunk->m_next = nullptr;
+		chunk->m_size = size;
+		if (m_last != nullptr) {
+			m_last->m_next = chunk;
+		}
+		else {
+			m_first = chunk;
+		}
+		m_last = chunk;
+		m_current = chunk;
+		m_capacity += size;
+	}
+
+	template<class Node>
+	NodeBatch<Node>::NodeBatch(NodePool<Node>& pool, std::mutex& mutex) noexcept
+		: m_pool{ pool }
+		, m_mutex{ mutex }
+	{
+	}
+
+	template<class Node>
+	NodeBatch<Node>::~NodeBatch() {
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		while (m_size > 0) {
+			m_pool.Release(m_nodes[--m_size]);
+		}
+	}
+
+	template<class Node>
+	Node* NodeBatch<Node>::Acquire() {
+		if (m_size == 0) {
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			while (m_size < BATCH_SIZE) {
+				m_nodes[m_size++] = m_pool.Acquire();
+			}
+		}
+		return m_nodes[--m_size];
+	}
+
+} // namespace tree
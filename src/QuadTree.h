@@ -1,66 +1,380 @@
 #pragma once
 
 #include "healthy.h"
+#include "Cardinals.h"
+#include "Morton.h"
+#include "ThreadPool.h"
+#include "InlineStack.h"
+#include "Simd.h"
+#include "NodePool.h"
+#include "LocationIndex.h"
 #include <array>
 #include <vector>
 #include <functional>
 #include <optional>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <queue>
+#include <iterator>
+#include <atomic>
+#include <cassert>
+#include <algorithm>
+#include <type_traits>
+#include <limits>
+#include <utility>
 
 namespace tree {
 
+	// the type of value stored with each point when the tree keeps only points
+	struct NoPayload {};
+
+	/**
+	 * Statistics of the points kept by each node for its subtree (see QuadTree::Reduce).
+	 * An aggregate is a monoid over the points:
+	 * - `Value` is the statistics, the default constructed one is the statistics of no points;
+	 * - `Make(point, payload)` returns the statistics of one point;
+	 * - `Combine(lhs, rhs)` is associative and returns the statistics of the points of both.
+	 * See Aggregates.h for the common ones. This one keeps nothing.
+	 */
+	struct NoAggregate {
+		struct Value {};
+
+		template<class Point, class Payload>
+		static constexpr Value Make(const Point&, const Payload&) noexcept {
+			return {};
+		}
+
+		static constexpr Value Combine(const Value&, const Value&) noexcept {
+			return {};
+		}
+	};
+
+	constexpr size_t DEFAULT_LEAF_CAPACITY{ 2 };
+
+	// nodes at this depth aren't divided anymore: their overflow leaves take the rest of points
+	constexpr size_t DEFAULT_MAX_DEPTH{ 32 };
+
 	/**
-	 * NE - corresponds to top-right quarter
-	 * SE - corresponds to bottom-right quarter
-	 * NW - corresponds to top-left quarter
-	 * SW - corresponds to bottom-left quarter
+	 * Stable reference to a point stored in the tree.
+	 * It stays valid while the point is in the tree no matter how the nodes are split or merged.
+	 * Handle of the erased point never refers to any other point.
 	 */
-	enum Cardinals { NW = 0, NE, SW, SE, COUNT };
+	struct Handle {
+		static constexpr uint32_t NONE{ std::numeric_limits<uint32_t>::max() };
+
+		// not an aggregate, so a braced point `{ x, y }` is never taken for a handle
+		constexpr Handle() noexcept {}
+
+		uint32_t m_index{ NONE };
+		uint32_t m_generation{ 0 };
 
+		// whether the handle was returned for some point (it may be already erased)
+		constexpr bool IsValid() const noexcept {
+			return m_index != NONE;
+		}
+	};
+
+	/**
+	 * When a leaf is merged into its parent after erasure of a point.
+	 * The node is split when it's full, so merging it back as soon as the points fit
+	 * makes a point oscillating around that threshold allocate and free the node every time.
+	 */
+	enum class MergePolicy {
+		// merge as soon as the points of the leaf and its parent fit the parent
+		EAGER,
+		// merge only when the leaf and its parent together have no more than the low-water mark of points
+		LOW_WATER,
+		// never merge on erasure: merge everything on `Compact`
+		DEFERRED
+	};
+
+	/**
+	 * Where the box of a leaf is divided into quarters when it gets the first child.
+	 * The division of the node is kept until it's a leaf again.
+	 */
+	enum class SplitPolicy {
+		// at the middle of the box
+		MIDPOINT,
+		// at the medians of the coordinates of the points: clustered points don't make long chains of nodes
+		// while the empty space isn't divided at all. The subtree which one quarter outweighs
+		// after insertion is rebuilt at the medians of all of its points.
+		MEDIAN
+	};
+
+	constexpr bool operator==(const Handle& lhs, const Handle& rhs) noexcept {
+		return lhs.m_index == rhs.m_index && lhs.m_generation == rhs.m_generation;
+	}
+
+	constexpr bool operator!=(const Handle& lhs, const Handle& rhs) noexcept {
+		return !(lhs == rhs);
+	}
+
+	template<class Payload, class Coord>
+	class FlatQuadTree;
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate = NoAggregate>
 	struct Node {
-		using pointer = std::unique_ptr<Node>;
+		// nodes are owned by the pool of the tree
+		using pointer = Node*;
+		using Point = mt::BasicPt<Coord>;
+		using Rect = mt::BasicRect<Coord>;
 
-		static constexpr size_t MAX_POINTS{ 2 };
+		static constexpr size_t MAX_POINTS{ LeafCapacity };
 
 		std::array<pointer, Cardinals::COUNT> m_children{ nullptr };
-		// TODO: rewrite to std::array
-		std::vector<mt::Pt> m_data;
-		mt::Rect m_box{ {0.f, 0.f}, {0.f, 0.f} };
+		// only the first `m_size` points and their values are in use
+		// coordinates are kept in separate arrays to be scanned by SIMD kernels
+		std::array<Coord, MAX_POINTS> m_xs;
+		std::array<Coord, MAX_POINTS> m_ys;
+		std::array<Payload, MAX_POINTS> m_values;
+		// slots of the tree's handles of the points
+		std::array<uint32_t, MAX_POINTS> m_handles;
+		uint32_t m_size{ 0 };
+		// number of points in the subtree including the node's ones (maintained by QuadTree)
+		uint32_t m_count{ 0 };
+		Rect m_box{ {0, 0}, {0, 0} };
+		// the point dividing the box when the division is Division::CENTER
+		Point m_center{ 0, 0 };
+		// how the box is divided between the children, it's chosen when the leaf gets the first child
+		Division m_division{ Division::MIDDLE };
+		// number of points in the subtree when it was built at the medians (SplitPolicy::MEDIAN)
+		uint32_t m_built{ 0 };
+		// locational code (see ROOT_CODE) while the tree keeps the location index, zero for the nodes out of the index
+		uint64_t m_code{ 0 };
+		// statistics of the points of the subtree (maintained by QuadTree)
+		typename Aggregate::Value m_aggregate{};
+
+		bool IsLeaf() const noexcept;
+
+		// return the quarter of the box where the point belongs
+		Cardinals GetQuarter(const Point& point) const noexcept;
+
+		// return the box of the child of the quarter
+		Rect GetQuarterBox(Cardinals cardinal) const noexcept;
+
+		// return mask of the quarters intersecting the area (see simd::IntersectQuarters)
+		unsigned IntersectQuarters(const Rect& area) const noexcept;
+
+		// whether the overflow leaf keeps the point itself while its quarter has a child
+		bool KeepsOverflow(const Point& point) const noexcept;
+
+		Point GetPoint(size_t index) const noexcept;
+
+		// return index of the point or `m_size` if the node doesn't have it
+		size_t Find(const Point& point) const noexcept;
+
+		void Push(const Point& point, Payload value, uint32_t handle);
+
+		// remove the point replacing it with the last one
+		void Remove(size_t index);
+
+		// remove all of points keeping the children
+		void Clear();
 	};
 
 	/**
-	 * @note this tree won't create a node for the forth quarter 
+	 * @tparam Payload the value stored with each point
+	 * @tparam Coord the type of coordinates, any arithmetic type
+	 * @tparam LeafCapacity maximum number of points kept by a node
+	 * @tparam Aggregate statistics of the subtrees kept by the nodes (see NoAggregate)
+	 *
+	 * @note this tree won't create a node for the forth quarter
 	 * until number of points there won't be greater than Node::MAX_POINTS
 	 */
+	template<
+		class Payload = NoPayload, class Coord = float, size_t LeafCapacity = DEFAULT_LEAF_CAPACITY,
+		class Aggregate = NoAggregate
+	>
 	class QuadTree {
+		static_assert(std::is_arithmetic_v<Coord>, "Coordinates must be of arithmetic type");
+		static_assert(LeafCapacity > 0, "Node must be able to keep at least one point");
+
 	public:
+		using Node = tree::Node<Payload, Coord, LeafCapacity, Aggregate>;
+		using Point = typename Node::Point;
+		using Rect = typename Node::Rect;
+		using Visitor_t = std::function<void(typename Node::pointer&)>;
+		using AggregateValue = typename Aggregate::Value;
+
+		// point stored in the tree with its value
+		struct Entry {
+			Point point;
+			Payload value;
+			Handle handle;
+		};
+
+		// points found for each of the areas: points of the i-th area are [offsets[i], offsets[i + 1])
+		struct BatchResult {
+			std::vector<size_t> offsets;
+			std::vector<Point> points;
+		};
 
-		using Visitor_t = std::function<void(Node::pointer&)>;
+		static constexpr size_t MAX_POINTS{ LeafCapacity };
+		// whether the nodes keep statistics of their subtrees
+		static constexpr bool HAS_AGGREGATE{ !std::is_same_v<Aggregate, NoAggregate> };
 
-		QuadTree(const mt::Rect& fullArea);
+		// number of nodes the traversal keeps without allocation; enough for the tree of depth ~40
+		static constexpr size_t INLINE_STACK_SIZE{ 128 };
+		// smaller subtrees aren't rebuilt when they're unbalanced (SplitPolicy::MEDIAN)
+		static constexpr size_t MIN_REBUILT{ 8 * MAX_POINTS };
 
-		~QuadTree() = default;
+		/**
+		 * Nodes and handles' slots are allocated from the memory resource.
+		 * The nodes are kept in the pool of the tree: released nodes are reused by later splits.
+		 */
+		explicit QuadTree(const Rect& fullArea, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+		~QuadTree();
 
-		void Build(const std::vector<mt::Pt>& points);
+		QuadTree(const QuadTree&) = delete;
+		QuadTree& operator=(const QuadTree&) = delete;
+
+		/**
+		 * Insert all of points into the tree.
+		 * The empty tree is bulk-loaded: points are sorted in Morton order and the tree is built
+		 * in one pass over them. The result is the same as inserting points one by one in that order.
+		 * With SplitPolicy::MEDIAN the boxes are divided at the medians of all points of the subtree instead.
+		 */
+		void Build(const std::vector<Point>& points);
+
+		/**
+		 * Insert all of points into the tree using threads of the pool.
+		 * The empty tree is built in parallel: subtrees of the quarters are disjoint
+		 * so they are built independently. The result is the same as the one of sequential `Build`.
+		 */
+		void Build(const std::vector<Point>& points, ThreadPool& pool);
 
 		// return all of points in the area
-		std::vector<mt::Pt> GetPointsAt(const mt::Rect& area) const noexcept;
+		std::vector<Point> GetPointsAt(const Rect& area) const noexcept;
+
+		// write all of points in the area to `out` and return the end of the output
+		template<class OutputIt>
+		OutputIt GetPointsAt(const Rect& area, OutputIt out) const;
+
+		/**
+		 * Return points of each of `count` areas.
+		 * The areas are ordered along Z-curve and the tree is traversed once:
+		 * each node is visited with the list of the areas which still intersect it.
+		 */
+		BatchResult GetPointsAt(const Rect* areas, size_t count) const;
+
+		/**
+		 * Return all of points in the area using threads of the pool.
+		 * The top levels are traversed until enough of subtrees intersect the area,
+		 * then the subtrees are traversed by the tasks collecting points to their own buffers.
+		 * The order of points is unspecified. It pays off for the areas covering large part of the tree.
+		 */
+		std::vector<Point> GetPointsAt(const Rect& area, ThreadPool& pool) const;
+
+		// return all of points in the area with their values and handles
+		std::vector<Entry> GetEntriesAt(const Rect& area) const;
+
+		/**
+		 * Call `visitor(point, value, handle)` for each point in the area.
+		 * The visitor may return false to stop the traversal early.
+		 * Return false if the traversal was stopped by the visitor.
+		 * The traversal doesn't allocate unless the tree is deeper than the inline stack.
+		 */
+		template<class Visitor>
+		bool ForEachAt(const Rect& area, Visitor&& visitor) const;
+
+		/**
+		 * Return number of points in the area.
+		 * Subtrees which boxes are inside the area are counted without visiting their nodes.
+		 */
+		size_t CountPointsAt(const Rect& area) const noexcept;
+
+		/**
+		 * Return the statistics (see Aggregate) of the points in the area.
+		 * Subtrees which boxes are inside the area contribute their statistics without visiting their nodes.
+		 */
+		AggregateValue Reduce(const Rect& area) const;
 
 		// return the closest neighbour point or nullopt if no points present
-		std::optional<mt::Pt> FindClosest(const mt::Pt& point) const noexcept;
+		std::optional<Point> FindClosest(const Point& point) const;
+
+		// return up to `k` points closest to the `point` ordered by distance (closest first)
+		std::vector<Point> FindKClosest(const Point& point, size_t k) const;
+
+		// return all of points which are not farther than `radius` from the `point`
+		std::vector<Point> FindWithinRadius(const Point& point, Coord radius) const;
+
+		/**
+		 * Return all of points which are not farther than `radius` from the `center`.
+		 * Subtrees which boxes are inside the circle are reported without testing their points.
+		 */
+		std::vector<Point> GetPointsInCircle(const Point& center, Coord radius) const;
+
+		// write all of points of the circle to `out` and return the end of the output
+		template<class OutputIt>
+		OutputIt GetPointsInCircle(const Point& center, Coord radius, OutputIt out) const;
+
+		/**
+		 * Return all of points inside the polygon of `count` vertices by the even-odd rule,
+		 * so it may be concave or self-intersecting. Points on the edges may be reported or not.
+		 * Subtrees which boxes aren't crossed by the edges are skipped or reported without testing their points.
+		 */
+		std::vector<Point> GetPointsInPolygon(const Point* vertices, size_t count) const;
+
+		// write all of points of the polygon to `out` and return the end of the output
+		template<class OutputIt>
+		OutputIt GetPointsInPolygon(const Point* vertices, size_t count, OutputIt out) const;
 
-		void Insert(const mt::Pt& point);
+		/**
+		 * Insert the point with the value unless the point is already in the tree.
+		 * Return handle of the inserted point or invalid handle if the point wasn't inserted.
+		 */
+		Handle Insert(const Point& point, Payload value = {});
+
+		bool Contains(const Point& point) const;
+
+		// check whether the handle refers to a point which is still in the tree
+		bool Contains(Handle handle) const noexcept;
+
+		// return the value stored with the point or nullptr if there is no such point
+		const Payload* Find(const Point& point) const;
+
+		Payload* Find(const Point& point);
+
+		// return the value of the point referred by the handle or nullptr if the point was erased
+		const Payload* Find(Handle handle) const;
+
+		Payload* Find(Handle handle);
 
-		bool Contains(const mt::Pt& point) const;
+		// return the point referred by the handle or nullopt if the point was erased
+		std::optional<Point> GetPoint(Handle handle) const noexcept;
 
 		/**
 		* Erase point from the tree.
 		* On successfull erasure trying to merge child nodes with parent node if possible
+		* Return whether the point was erased.
 		*/
-		void Erase(const mt::Pt& point);
+		bool Erase(const Point& point);
+
+		// erase the point referred by the handle
+		bool Erase(Handle handle);
+
+		/**
+		 * Move the point to the new position keeping its value and handle.
+		 * Only the subtree of the deepest node which box has both of positions is updated,
+		 * the point which stays in the same node is just overwritten.
+		 * Return false and leave the tree unchanged if there is no such point,
+		 * the new position is outside the boundary or is taken by another point.
+		 */
+		bool Move(const Point& from, const Point& to);
+
+		bool Move(Handle handle, const Point& to);
+
+		/**
+		 * Apply the moves (old and new positions) in Morton order of the old positions,
+		 * so the consecutive moves walk the neighbouring nodes.
+		 * Return number of moved points.
+		 */
+		size_t MoveMany(const std::vector<std::pair<Point, Point>>& moves);
 
 		void PostOrderVisit(const Visitor_t& func);
-		
+
 		void PreOrderVisit(const Visitor_t& func);
 
 		bool IsEmpty() const noexcept;
@@ -68,36 +382,2220 @@ namespace tree {
 		// retrun number of points in the tree
 		size_t GetSize() const noexcept;
 
+		/**
+		 * Remove all of points invalidating their handles.
+		 * Memory of the nodes is kept for reuse, so it takes constant time unless
+		 * the nodes have to be destroyed one by one (payload isn't trivially destructible).
+		 */
 		void Clear();
 
+		/**
+		 * Set when leaves are merged into their parents on erasure.
+		 * The low-water mark is used by MergePolicy::LOW_WATER only.
+		 */
+		void SetMergePolicy(MergePolicy policy, size_t lowWater = LeafCapacity / 2) noexcept;
+
+		MergePolicy GetMergePolicy() const noexcept;
+
+		/**
+		 * Set how the leaves are divided into quarters and the depth of the nodes which aren't divided anymore.
+		 * A full node at the maximum depth becomes an overflow leaf: it keeps its points and passes the rest
+		 * to its only child with the same box. The nodes which are already divided keep their division.
+		 */
+		void SetSplitPolicy(SplitPolicy policy, size_t maxDepth = DEFAULT_MAX_DEPTH) noexcept;
+
+		SplitPolicy GetSplitPolicy() const noexcept;
+
+		size_t GetMaxDepth() const noexcept;
+
+		/**
+		 * Set the minimum size of the quarters: the node which quarters would be smaller isn't divided
+		 * and becomes an overflow leaf like the node at the maximum depth, so points closer than the size
+		 * to each other (e.g. jitter of the same position) don't make deep chains of divisions.
+		 * The box which middle can't be represented by `Coord` isn't divided whatever the size is.
+		 */
+		void SetMinCellSize(Coord size) noexcept;
+
+		Coord GetMinCellSize() const noexcept;
+
+		/**
+		 * Keep the hash map from the locational codes (see ROOT_CODE) of the nodes to the nodes.
+		 * `Contains` and `Find` then jump to the deepest indexed node on the way to the point
+		 * by binary search over its depth instead of descending from the root.
+		 * Only the nodes which ancestors are divided at the middle are indexed down to MAX_CODE_DEPTH:
+		 * the subtrees divided at the medians, the overflow leaves and the deeper nodes are descended as usual.
+		 * Each split and merge updates the index.
+		 */
+		void SetLocationIndex(bool enabled);
+
+		bool HasLocationIndex() const noexcept;
+
+		// return the deepest node which box has the point (it keeps the point or gets it on insertion), nullptr outside the boundary
+		const Node* Locate(const Point& point) const noexcept;
+
+		/**
+		 * Return the deepest indexed node covering the cell of the node's size beside the side of the node.
+		 * It's an ancestor of the node when the area beside it has no node of its own (its points are kept by the ancestor).
+		 * Return nullptr for the node at that side of the boundary and for the node out of the location index.
+		 */
+		const Node* FindNeighbour(const Node& node, Side side) const noexcept;
+
+		// merge all of leaves which points fit their parents
+		void Compact();
+
 	private:
 
-		void Erase(Node::pointer& node, Node::pointer& parent, const mt::Pt& point);
+		struct MortonItem {
+			uint64_t code;
+			Point point;
+			Payload value;
+			uint32_t handle;
+		};
+
+		// the link to the node visited depth-first and the next of its children
+		struct VisitFrame {
+			typename Node::pointer* node;
+			size_t next;
+		};
+
+		// value and handle of the point taken out of the tree
+		struct Extracted {
+			Payload value;
+			uint32_t handle;
+		};
+
+		// the point referred by the handle
+		struct Slot {
+			Point m_point;
+			// incremented each time the slot is released so old handles don't match
+			uint32_t m_generation{ 0 };
+			bool m_used{ false };
+		};
+
+		// point found for the area of the batch
+		struct BatchHit {
+			uint32_t area;
+			Point point;
+		};
+
+		// node of the batch traversal with its areas active[first, last) and the next of its children
+		struct BatchFrame {
+			const Node* node;
+			size_t first;
+			size_t last;
+			size_t next;
+		};
+
+		// sorted unique points of the subtree at the top levels and the number of points stored in it
+		struct Bucket {
+			MortonItem* first{ nullptr };
+			MortonItem* last{ nullptr };
+			size_t size{ 0 };
+		};
+
+		// build top levels of the empty `node` spawning tasks for the subtrees of the buckets
+		// return number of points stored in the nodes of the top levels
+		size_t Build(
+			typename Node::pointer& node, Bucket* first, Bucket* last, size_t level, TaskGroup& group, std::mutex& poolMutex
+		);
+
+		// build subtree of the empty `node` from unique points sorted in Morton order
+		// return number of points in the subtree
+		size_t Build(
+			typename Node::pointer& node, MortonItem* first, MortonItem* last, size_t level, NodeBatch<Node>& nodes
+		);
+
+		// build subtree of the empty `node` dividing the boxes at the medians of the points (see SplitPolicy::MEDIAN)
+		// return number of points in the subtree
+		size_t BuildAtMedians(
+			typename Node::pointer& node, MortonItem* first, MortonItem* last, size_t level, NodeBatch<Node>& nodes
+		);
+
+		// build the chain of overflow leaves from the empty `node` keeping the points in order
+		// return number of points in the chain
+		size_t BuildOverflow(typename Node::pointer& node, MortonItem* first, MortonItem* last, NodeBatch<Node>& nodes);
+
+		// store the point of the item in the node while building the tree
+		void Store(Node& node, MortonItem& item);
+
+		// prepare the slots of the empty tree for bulk-loading: i-th point gets i-th slot
+		void ResetSlots(size_t count);
+
+		// collect the slots not used by the points of bulk-loaded tree
+		void CollectFreeSlots();
+
+		uint32_t AcquireSlot(const Point& point);
+
+		void ReleaseSlot(uint32_t slot);
+
+		Handle MakeHandle(uint32_t slot) const noexcept;
+
+		// return nodes of the subtree to the pool
+		void Release(typename Node::pointer node) noexcept;
+
+		// take the point out of the subtree restoring properties of the tree below the `parent`
+		std::optional<Extracted> Erase(typename Node::pointer& node, typename Node::pointer& parent, const Point& point);
 
 		// apply func each node while traversing tree
-		void PostOrderVisit(Node::pointer& node, const Visitor_t& func);
+		void PostOrderVisit(typename Node::pointer& node, const Visitor_t& func);
+
+		// merge the leaf into the parent if the merge policy allows
+		void Merge(typename Node::pointer& child, typename Node::pointer& parent);
+
+		void Compact(typename Node::pointer& node, typename Node::pointer& parent);
 
-		void PreOrderVisit(Node::pointer& node, const Visitor_t& func);
+		void PreOrderVisit(typename Node::pointer& node, const Visitor_t& func);
+
+		// visit points of the node's subtree which are in the area
+		template<class Visitor>
+		bool ForEachAt(const Node* node, const Rect& area, Visitor& visitor) const;
+
+		// visit all of points of the node's subtree
+		template<class Visitor>
+		bool ForEach(const Node* node, Visitor& visitor) const;
+
+		// return number of points of the subtree and set it and the statistics for the nodes above `depth`
+		size_t Recount(Node* node, size_t depth, size_t levels);
+
+		// compute statistics of the node from its points and the statistics of its children
+		void Summarize(Node& node) const;
+
+		// add the point to the statistics of the node
+		void Accumulate(Node& node, const Point& point, const Payload& value) const;
+
+		// recompute statistics of the nodes on the path from the root to the `node` (exclusive) passing the `point`
+		void SummarizeAncestors(const Node* node, const Point& point) const;
+
+		// collect points of the node's subtree for the areas which indices are active[first, last)
+		void GetPointsAt(
+			const Node* node, const Rect* areas, std::vector<uint32_t>& active, size_t first, size_t last,
+			std::vector<BatchHit>& hits
+		) const;
 
 		// Find the point in the node
-		bool Contains(const Node::pointer& node, const mt::Pt& point) const noexcept;
+		const Payload* Find(const Node* node, const Point& point) const noexcept;
+
+		// return the deepest indexed node on the way to the point or the root
+		Node* FindIndexed(const Point& point) const noexcept;
+
+		// give the codes to the nodes of the subtree starting from the node's `code` and add them to the index
+		void Index(Node& node, uint64_t code);
+
+		// give the child its code if the parent's box is divided at the middle and add it to the index
+		void IndexChild(const Node& parent, Cardinals cardinal, Node& child);
+
+		// Insert `point` into the `node` at the `depth` and return the stored value or nullptr if the point wasn't inserted
+		const Payload* Insert(
+			const typename Node::pointer& node, const Point& point, Payload& value, uint32_t handle, size_t depth
+		);
+
+		// whether the node of the box at the `depth` may be divided or is an overflow leaf
+		bool IsDivisible(const Rect& box, size_t depth) const noexcept;
+
+		// choose the division of the full leaf at the `depth` which gets the child for the `point`
+		void Divide(Node& node, const Point& point, size_t depth) const;
 
-		// Insert `point` into the `node`
-		bool Insert(const Node::pointer& node, const mt::Pt& point);
+		// rebuild the highest unbalanced subtree on the path of the inserted point (SplitPolicy::MEDIAN)
+		void Rebalance(const Point& point);
+
+		// rebuild the subtree of the node at the `depth` at the medians of its points
+		void Rebuild(typename Node::pointer& node, size_t depth);
 
 	private:
-		Node::pointer m_root{ nullptr };
+		NodePool<Node> m_pool;
+		typename Node::pointer m_root{ nullptr };
 		// number of vertices in the tree
 		size_t m_size{ 0 };
+
+		// handles refer to the slots, nodes keep indices of the slots of their points
+		std::pmr::vector<Slot> m_slots;
+		std::pmr::vector<uint32_t> m_freeSlots;
+		// slots created after `Clear` start from this generation, so handles issued before it don't match them
+		uint32_t m_firstGeneration{ 0 };
+		// no handle has greater generation
+		uint32_t m_maxGeneration{ 0 };
+
+		MergePolicy m_mergePolicy{ MergePolicy::EAGER };
+		// maximum number of points of the merged node
+		size_t m_mergeLimit{ MAX_POINTS };
+
+		SplitPolicy m_splitPolicy{ SplitPolicy::MIDPOINT };
+		size_t m_maxDepth{ DEFAULT_MAX_DEPTH };
+		Coord m_minCellSize{ 0 };
+
+		// nodes of the regular subdivision by their codes, it's empty unless `m_indexed`
+		LocationIndex<Node> m_index;
+		bool m_indexed{ false };
+
+		// writes the nodes to the file
+		template<class, class>
+		friend class FlatQuadTree;
 	};
 
+	namespace detail {
+
+		/**
+		* Trying to get rid of the child node (leaf) transfering it's data to parent beforehand
+		* The node is merged when the parent would have no more than `limit` points.
+		*/
+		template<class Node>
+		void TryMerge(Node*& child, Node*& parent, NodePool<Node>& pool, size_t limit = Node::MAX_POINTS) {
+			assert(parent != child && "Can't merge root");
+			assert(child->IsLeaf() && "Trying to merge non-leaf node");
+			assert(limit <= Node::MAX_POINTS && "Node can't keep so many points");
+
+			if (child->m_size + parent->m_size <= limit) {
+				for (size_t i = 0; i < child->m_size; i++) {
+					parent->Push(child->GetPoint(i), std::move(child->m_values[i]), child->m_handles[i]);
+				}
+				pool.Release(child);
+				child = nullptr;
+			}
+		}
+
+		/**
+		* Remove repeated points from the range sorted by Morton code.
+		* Equal points have equal codes so only the runs of the same code are examined.
+		* The first of equal points is kept.
+		* Return the end of the range of unique points.
+		*/
+		template<class Item>
+		Item* RemoveDuplicates(Item* first, Item* last) {
+			const auto isLess = [](const Item& lhs, const Item& rhs) {
+				return lhs.point.x < rhs.point.x || (lhs.point.x == rhs.point.x && lhs.point.y < rhs.point.y);
+			};
+			const auto isSame = [](const Item& lhs, const Item& rhs) {
+				return lhs.point == rhs.point;
+			};
+
+			auto unique = first;
+			for (auto run = first; run != last; ) {
+				const auto runEnd = std::find_if(run + 1, last, [code = run->code](const Item& item) {
+					return item.code != code;
+				});
+				if (runEnd - run > 1) {
+					std::stable_sort(run, runEnd, isLess);
+				}
+				for (auto prev = run; run != runEnd; run++) {
+					if (run == prev || !isSame(*run, *prev)) {
+						prev = run;
+						if (unique != run) {
+							*unique = std::move(*run);
+						}
+						unique++;
+					}
+				}
+			}
+			return unique;
+		}
+
+		// invoke the visitor and return whether the traversal should go on
+		template<class Visitor, class ...Args>
+		bool Visit(Visitor& visitor, Args&&... args) {
+			if constexpr (std::is_void_v<std::invoke_result_t<Visitor&, Args...>>) {
+				std::invoke(visitor, std::forward<Args>(args)...);
+				return true;
+			}
+			else {
+				return static_cast<bool>(std::invoke(visitor, std::forward<Args>(args)...));
+			}
+		}
+
+		/**
+		* Return the median of `get(item)` over the range reordering it.
+		* The middle of both medians is returned for the range of even size.
+		*/
+		template<class Iterator, class Get>
+		auto GetMedian(Iterator first, Iterator last, Get get) {
+			const auto less = [&get](const auto& lhs, const auto& rhs) {
+				return get(lhs) < get(rhs);
+			};
+			const auto half = (last - first) / 2;
+			std::nth_element(first, first + half, last, less);
+			const auto upper = get(first[half]);
+			if ((last - first) % 2 != 0) {
+				return upper;
+			}
+			const auto lower = get(*std::max_element(first, first + half, less));
+			return static_cast<decltype(upper)>(lower + (upper - lower) / 2);
+		}
+
+		/**
+		* Check whether the point is lost by rounding of the boundaries of quarters
+		* at the first `levels` levels of subdivision.
+		*/
+		template<class Coord>
+		bool IsLost(const mt::BasicPt<Coord>& point, mt::BasicRect<Coord> box, size_t levels) noexcept {
+			for (size_t level = 0; level < levels; level++) {
+				box = GetRect(GetQuarter(point, box), box);
+				if (!box.Contains(point)) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/**
+		* Whether the point is inside the polygon by the even-odd rule: the ray from the point
+		* to the east crosses the edges odd number of times.
+		*/
+		template<class Coord>
+		bool IsInPolygon(const mt::BasicPt<Coord>& point, const mt::BasicPt<Coord>* vertices, size_t count) noexcept {
+			const double x = static_cast<double>(point.x);
+			const double y = static_cast<double>(point.y);
+			bool inside{ false };
+			for (size_t i = 0, j = count - 1; i < count; j = i++) {
+				const double xi = static_cast<double>(vertices[i].x);
+				const double yi = static_cast<double>(vertices[i].y);
+				const double xj = static_cast<double>(vertices[j].x);
+				const double yj = static_cast<double>(vertices[j].y);
+				if ((yi > y) != (yj > y) && x < xi + (xj - xi) * (y - yi) / (yj - yi)) {
+					inside = !inside;
+				}
+			}
+			return inside;
+		}
+
+		/**
+		* Whether the segment crosses or touches the box including its far edges.
+		* Separating axis test: the segment misses the box if their extents don't overlap
+		* or all of the box's corners are on one side of the segment's line.
+		*/
+		template<class Coord>
+		bool IsCrossing(const mt::BasicPt<Coord>& from, const mt::BasicPt<Coord>& to, const mt::BasicRect<Coord>& box) noexcept {
+			const double minX = static_cast<double>(box.GetMinX());
+			const double minY = static_cast<double>(box.GetMinY());
+			const double maxX = static_cast<double>(box.GetMaxX());
+			const double maxY = static_cast<double>(box.GetMaxY());
+			const double x0 = static_cast<double>(from.x);
+			const double y0 = static_cast<double>(from.y);
+			const double x1 = static_cast<double>(to.x);
+			const double y1 = static_cast<double>(to.y);
+			if (std::max(x0, x1) < minX || std::min(x0, x1) > maxX || std::max(y0, y1) < minY || std::min(y0, y1) > maxY) {
+				return false;
+			}
+			const auto side = [=](double x, double y) {
+				return (x1 - x0) * (y - y0) - (y1 - y0) * (x - x0);
+			};
+			const std::array<double, 4> sides{ side(minX, minY), side(maxX, minY), side(minX, maxY), side(maxX, maxY) };
+			return !(std::all_of(sides.cbegin(), sides.cend(), [](double value) { return value > 0.0; })
+				|| std::all_of(sides.cbegin(), sides.cend(), [](double value) { return value < 0.0; }));
+		}
+
+	} // namespace detail
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	bool Node<Payload, Coord, LeafCapacity, Aggregate>::IsLeaf() const noexcept {
+		return std::all_of(m_children.cbegin(), m_children.cend(), [](const pointer& child) {
+			return child == nullptr;
+		});
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	Cardinals Node<Payload, Coord, LeafCapacity, Aggregate>::GetQuarter(const Point& point) const noexcept {
+		return tree::GetQuarter(point, m_box, m_division, m_center);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto Node<Payload, Coord, LeafCapacity, Aggregate>::GetQuarterBox(Cardinals cardinal) const noexcept -> Rect {
+		return GetRect(cardinal, m_box, m_division, m_center);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	unsigned Node<Payload, Coord, LeafCapacity, Aggregate>::IntersectQuarters(const Rect& area) const noexcept {
+		return simd::IntersectQuarters(m_box, m_division, m_center, area);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	bool Node<Payload, Coord, LeafCapacity, Aggregate>::KeepsOverflow(const Point& point) const noexcept {
+		return m_division == Division::NONE && Find(point) < m_size;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto Node<Payload, Coord, LeafCapacity, Aggregate>::GetPoint(size_t index) const noexcept -> Point {
+		return { m_xs[index], m_ys[index] };
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	size_t Node<Payload, Coord, LeafCapacity, Aggregate>::Find(const Point& point) const noexcept {
+		size_t index{ 0 };
+		while (index < m_size && !(m_xs[index] == point.x && m_ys[index] == point.y)) {
+			index++;
+		}
+		return index;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void Node<Payload, Coord, LeafCapacity, Aggregate>::Push(const Point& point, Payload value, uint32_t handle) {
+		assert(m_size < MAX_POINTS && "Node is full");
+		m_xs[m_size] = point.x;
+		m_ys[m_size] = point.y;
+		m_values[m_size] = std::move(value);
+		m_handles[m_size] = handle;
+		m_size++;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void Node<Payload, Coord, LeafCapacity, Aggregate>::Remove(size_t index) {
+		assert(index < m_size && "Index is out of range");
+		const size_t last = m_size - 1;
+		if (index != last) {
+			m_xs[index] = m_xs[last];
+			m_ys[index] = m_ys[last];
+			m_values[index] = std::move(m_values[last]);
+			m_handles[index] = m_handles[last];
+		}
+		// release resources of the value
+		m_values[last] = Payload{};
+		m_size--;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void Node<Payload, Coord, LeafCapacity, Aggregate>::Clear() {
+		while (m_size > 0) {
+			Remove(m_size - 1);
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	QuadTree<Payload, Coord, LeafCapacity, Aggregate>::QuadTree(const Rect& fullArea, std::pmr::memory_resource* resource)
+		: m_pool{ resource }
+		, m_root{ m_pool.Acquire() }
+		, m_size{ 0 }
+		, m_slots{ resource }
+		, m_freeSlots{ resource }
+		, m_index{ resource }
+	{
+		m_root->m_box = fullArea;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	QuadTree<Payload, Coord, LeafCapacity, Aggregate>::~QuadTree() {
+		// memory is freed by the pool
+		if constexpr (!std::is_trivially_destructible_v<Node>) {
+			Release(m_root);
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Clear() {
+		const Rect box = m_root->m_box;
+		if constexpr (!std::is_trivially_destructible_v<Node>) {
+			Release(m_root);
+		}
+		m_pool.Reset();
+		m_root = m_pool.Acquire();
+		m_root->m_box = box;
+		m_index.Clear();
+		if (m_indexed) {
+			Index(*m_root, ROOT_CODE);
+		}
+		m_size = 0;
+		// invalidate handles of all of points: new slots get generation none of them has
+		m_slots.clear();
+		m_freeSlots.clear();
+		m_firstGeneration = ++m_maxGeneration;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Build(const std::vector<Point>& points) {
+		if (!IsEmpty()) {
+			// keep the structure of the existing tree
+			for (auto& point : points) {
+				Insert(point);
+			}
+			return;
+		}
+
+		ResetSlots(points.size());
+		std::vector<MortonItem> sorted;
+		sorted.reserve(points.size());
+		for (size_t i = 0; i < points.size(); i++) {
+			// point is outside the boundary
+			if (m_root->m_box.Contains(points[i])) {
+				sorted.push_back({ GetMortonCode(points[i], m_root->m_box), points[i], Payload{}, static_cast<uint32_t>(i) });
+			}
+		}
+		RadixSort(sorted);
+		const auto last = detail::RemoveDuplicates(sorted.data(), sorted.data() + sorted.size());
+
+		std::mutex poolMutex;
+		NodeBatch<Node> nodes{ m_pool, poolMutex };
+		if (m_splitPolicy == SplitPolicy::MEDIAN) {
+			m_size = BuildAtMedians(m_root, sorted.data(), last, 0, nodes);
+		}
+		else {
+			m_size = Build(m_root, sorted.data(), last, 0, nodes);
+		}
+		if (m_indexed) {
+			Index(*m_root, ROOT_CODE);
+		}
+		CollectFreeSlots();
+	}
+
+	/**
+	 * The points are distributed between buckets by the quarters of the first few levels
+	 * which are built as separate tasks:
+	 * 1. compute Morton codes of the chunks of input and count points of each bucket;
+	 * 2. scatter points to their buckets;
+	 * 3. sort and deduplicate each bucket;
+	 * 4. build the top levels of the tree and the subtrees of buckets.
+	 * The result is the same as the one built by sequential `Build`.
+	 */
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Build(const std::vector<Point>& points, ThreadPool& pool) {
+		// minimum number of points processed by one task while computing codes
+		constexpr size_t MIN_CHUNK{ 1 << 14 };
+		// at least this number of buckets per thread to balance the load
+		constexpr size_t BUCKETS_PER_THREAD{ 16 };
+		constexpr size_t MAX_LEVELS{ 6 };
+
+		const Rect box = m_root->m_box;
+		const size_t threads = pool.GetThreadCount();
+		size_t levels{ 1 };
+		while (levels < MAX_LEVELS && (size_t{ 1 } << (2 * levels)) < BUCKETS_PER_THREAD * threads) {
+			levels++;
+		}
+		// the buckets are the quarters at the middle of the boxes of the top levels
+		bool divisible{ true };
+		Rect northWest = box;
+		Rect southEast = box;
+		for (size_t level = 0; level < levels; level++) {
+			// the corners have the smallest and the largest coordinates which are rounded the most
+			divisible = divisible && IsDivisible(northWest, level) && IsDivisible(southEast, level);
+			northWest = GetRect(Cardinals::NW, northWest);
+			southEast = GetRect(Cardinals::SE, southEast);
+		}
+		if (!IsEmpty() || m_splitPolicy != SplitPolicy::MIDPOINT || !divisible) {
+			Build(points);
+			return;
+		}
+		const size_t buckets = size_t{ 1 } << (2 * levels);
+		const size_t shift = 2 * (MORTON_LEVELS - levels);
+		const size_t chunks = std::max(size_t{ 1 }, std::min(threads * 4, points.size() / MIN_CHUNK));
+		const size_t chunkSize = (points.size() + chunks - 1) / chunks;
+
+		ResetSlots(points.size());
+		// number of points of each bucket in each chunk
+		std::vector<std::vector<size_t>> counts(chunks, std::vector<size_t>(buckets, 0));
+		// points with codes are kept at the beginning of their chunk
+		std::vector<MortonItem> coded(points.size());
+		std::vector<size_t> codedSizes(chunks, 0);
+		std::atomic<bool> hasLostPoints{ false };
+		std::vector<MortonItem> sorted;
+		std::vector<Bucket> ranges(buckets);
+
+		TaskGroup group{ pool };
+		for (size_t chunk = 0; chunk < chunks; chunk++) {
+			group.Run([&, chunk]() {
+				const size_t first = chunk * chunkSize;
+				const size_t last = std::min(first + chunkSize, points.size());
+				auto& count = counts[chunk];
+				size_t size{ 0 };
+				for (size_t i = first; i < last; i++) {
+					// point is outside the boundary
+					if (!box.Contains(points[i])) {
+						continue;
+					}
+					if (detail::IsLost(points[i], box, levels)) {
+						hasLostPoints = true;
+					}
+					auto& item = coded[first + size++];
+					item = { GetMortonCode(points[i], box), points[i], Payload{}, static_cast<uint32_t>(i) };
+					count[item.code >> shift]++;
+				}
+				codedSizes[chunk] = size;
+			});
+		}
+		group.Wait();
+
+		if (hasLostPoints) {
+			// top levels must drop some points: let sequential algorithm deal with this rare case
+			Build(points);
+			return;
+		}
+
+		// offsets of each bucket in each chunk
+		size_t total{ 0 };
+		for (size_t bucket = 0; bucket < buckets; bucket++) {
+			const size_t begin = total;
+			for (auto& count : counts) {
+				total += std::exchange(count[bucket], total);
+			}
+			ranges[bucket].size = total - begin;
+		}
+		sorted.resize(total);
+		for (size_t chunk = 0; chunk < chunks; chunk++) {
+			group.Run([&, chunk]() {
+				auto& offsets = counts[chunk];
+				const auto first = coded.begin() + chunk * chunkSize;
+				for (auto item = first; item != first + codedSizes[chunk]; item++) {
+					sorted[offsets[item->code >> shift]++] = std::move(*item);
+				}
+			});
+		}
+		group.Wait();
+		coded = {};
+
+		auto bucketFirst = sorted.data();
+		for (auto& range : ranges) {
+			range.first = bucketFirst;
+			range.last = bucketFirst + range.size;
+			bucketFirst = range.last;
+			if (range.first != range.last) {
+				group.Run([&range]() {
+					RadixSort(range.first, range.last);
+					range.last = detail::RemoveDuplicates(range.first, range.last);
+				});
+			}
+		}
+		group.Wait();
+
+		// tasks take nodes from the pool in batches
+		std::mutex poolMutex;
+		const size_t topSize = Build(m_root, ranges.data(), ranges.data() + ranges.size(), 0, group, poolMutex);
+		group.Wait();
+
+		m_size = topSize;
+		for (const auto& range : ranges) {
+			m_size += range.size;
+		}
+		// subtrees of the buckets are counted by their tasks
+		Recount(m_root, 0, levels);
+		if (m_indexed) {
+			Index(*m_root, ROOT_CODE);
+		}
+		CollectFreeSlots();
+	}
+
+	// return all of points in the area
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetPointsAt(const Rect& area) const noexcept -> std::vector<Point> {
+		std::vector<Point> points;
+		GetPointsAt(area, std::back_inserter(points));
+		return points;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	template<class OutputIt>
+	OutputIt QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetPointsAt(const Rect& area, OutputIt out) const {
+		ForEachAt(area, [&out](const Point& point, const Payload&, Handle) {
+			*out++ = point;
+		});
+		return out;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetPointsAt(const Rect* areas, size_t count) const -> BatchResult {
+		assert(count < std::numeric_limits<uint32_t>::max() && "Too many areas");
+
+		// neighbouring areas are likely to share the same nodes
+		struct Query {
+			uint64_t code;
+			uint32_t area;
+		};
+		std::vector<Query> queries;
+		queries.reserve(count);
+		for (size_t i = 0; i < count; i++) {
+			if (areas[i].Intersect(m_root->m_box)) {
+				const Point center{ areas[i].origin.x + areas[i].size.width / 2, areas[i].origin.y + areas[i].size.height / 2 };
+				queries.push_back({ GetMortonCode(center, m_root->m_box), static_cast<uint32_t>(i) });
+			}
+		}
+		RadixSort(queries);
+
+		std::vector<uint32_t> active;
+		active.reserve(queries.size() * 2);
+		for (const auto& query : queries) {
+			active.push_back(query.area);
+		}
+		std::vector<BatchHit> hits;
+		if (!active.empty()) {
+			GetPointsAt(m_root, areas, active, 0, active.size(), hits);
+		}
+
+		// group points by the areas keeping the order they were found
+		BatchResult result;
+		result.offsets.assign(count + 1, 0);
+		for (const auto& hit : hits) {
+			result.offsets[hit.area + 1]++;
+		}
+		for (size_t i = 1; i <= count; i++) {
+			result.offsets[i] += result.offsets[i - 1];
+		}
+		result.points.resize(hits.size());
+		std::vector<size_t> next(result.offsets.cbegin(), result.offsets.cend() - 1);
+		for (const auto& hit : hits) {
+			result.points[next[hit.area]++] = hit.point;
+		}
+		return result;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetPointsAt(const Rect& area, ThreadPool& pool) const -> std::vector<Point> {
+		// enough subtrees to balance the load between threads
+		constexpr size_t SUBTREES_PER_THREAD{ 8 };
+		const size_t subtrees = std::max(size_t{ 1 }, pool.GetThreadCount()) * SUBTREES_PER_THREAD;
+
+		// points of the top levels go first
+		std::vector<Point> points;
+		std::vector<const Node*> frontier{ m_root };
+		std::vector<const Node*> next;
+		std::array<uint32_t, MAX_POINTS> found;
+		while (!frontier.empty() && frontier.size() < subtrees) {
+			next.clear();
+			for (const auto node : frontier) {
+				const size_t count = simd::FindInRect(node->m_xs.data(), node->m_ys.data(), node->m_size, area, found.data());
+				for (size_t k = 0; k < count; k++) {
+					points.push_back(node->GetPoint(found[k]));
+				}
+				const unsigned quarters = node->IntersectQuarters(area);
+				for (size_t i = 0; i < Cardinals::COUNT; i++) {
+					if (node->m_children[i] && (quarters & (1u << i))) {
+						next.push_back(node->m_children[i]);
+					}
+				}
+			}
+			frontier.swap(next);
+		}
+		if (frontier.empty()) {
+			return points;
+		}
+
+		TaskGroup group{ pool };
+		std::vector<std::vector<Point>> buffers(frontier.size());
+		for (size_t i = 0; i < frontier.size(); i++) {
+			group.Run([this, &area, &buffer = buffers[i], node = frontier[i]]() {
+				auto collect = [&buffer](const Point& point, const Payload&, Handle) {
+					buffer.push_back(point);
+				};
+				ForEachAt(node, area, collect);
+			});
+		}
+		group.Wait();
+
+		// merge the buffers copying them in parallel
+		std::vector<size_t> offsets(buffers.size() + 1, points.size());
+		for (size_t i = 0; i < buffers.size(); i++) {
+			offsets[i + 1] = offsets[i] + buffers[i].size();
+		}
+		points.resize(offsets.back());
+		for (size_t i = 0; i < buffers.size(); i++) {
+			group.Run([&points, &buffer = buffers[i], offset = offsets[i]]() {
+				std::copy(buffer.cbegin(), buffer.cend(), points.begin() + offset);
+			});
+		}
+		group.Wait();
+		return points;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetEntriesAt(const Rect& area) const -> std::vector<Entry> {
+		std::vector<Entry> entries;
+		ForEachAt(area, [&entries](const Point& point, const Payload& value, Handle handle) {
+			entries.push_back({ point, value, handle });
+		});
+		return entries;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	template<class Visitor>
+	bool QuadTree<Payload, Coord, LeafCapacity, Aggregate>::ForEachAt(const Rect& area, Visitor&& visitor) const {
+		return ForEachAt(m_root, area, visitor);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	template<class Visitor>
+	bool QuadTree<Payload, Coord, LeafCapacity, Aggregate>::ForEachAt(const Node* node, const Rect& area, Visitor& visitor) const {
+		InlineStack<const Node*, INLINE_STACK_SIZE> processed;
+		processed.Push(node);
+		std::array<uint32_t, MAX_POINTS> found;
+
+		while (!processed.IsEmpty()) {
+			const auto current = processed.Pop();
+			// all of points of the subtree are in the area
+			if (area.Covers(current->m_box)) {
+				if (!ForEach(current, visitor)) {
+					return false;
+				}
+				continue;
+			}
+
+			const size_t count = simd::FindInRect(current->m_xs.data(), current->m_ys.data(), current->m_size, area, found.data());
+			for (size_t k = 0; k < count; k++) {
+				const auto i = found[k];
+				if (!detail::Visit(visitor, current->GetPoint(i), current->m_values[i], MakeHandle(current->m_handles[i]))) {
+					return false;
+				}
+			}
+
+			// children's boxes are the quarters of the node's box
+			const unsigned quarters = current->IntersectQuarters(area);
+			for (size_t i = 0; i < Cardinals::COUNT; i++) {
+				if (current->m_children[i] && (quarters & (1u << i))) {
+					processed.Push(current->m_children[i]);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	template<class Visitor>
+	bool QuadTree<Payload, Coord, LeafCapacity, Aggregate>::ForEach(const Node* node, Visitor& visitor) const {
+		InlineStack<const Node*, INLINE_STACK_SIZE> processed;
+		processed.Push(node);
+
+		while (!processed.IsEmpty()) {
+			const auto current = processed.Pop();
+			for (size_t i = 0; i < current->m_size; i++) {
+				if (!detail::Visit(visitor, current->GetPoint(i), current->m_values[i], MakeHandle(current->m_handles[i]))) {
+					return false;
+				}
+			}
+			for (const auto child : current->m_children) {
+				if (child) {
+					processed.Push(child);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	size_t QuadTree<Payload, Coord, LeafCapacity, Aggregate>::CountPointsAt(const Rect& area) const noexcept {
+		// only the nodes crossed by the boundary of the area are visited
+		InlineStack<const Node*, INLINE_STACK_SIZE> processed;
+		processed.Push(m_root);
+		std::array<uint32_t, MAX_POINTS> found;
+
+		size_t total{ 0 };
+		while (!processed.IsEmpty()) {
+			const auto current = processed.Pop();
+			if (area.Covers(current->m_box)) {
+				total += current->m_count;
+				continue;
+			}
+
+			total += simd::FindInRect(current->m_xs.data(), current->m_ys.data(), current->m_size, area, found.data());
+			const unsigned quarters = current->IntersectQuarters(area);
+			for (size_t i = 0; i < Cardinals::COUNT; i++) {
+				if (current->m_children[i] && (quarters & (1u << i))) {
+					processed.Push(current->m_children[i]);
+				}
+			}
+		}
+		return total;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Reduce(const Rect& area) const -> AggregateValue {
+		InlineStack<const Node*, INLINE_STACK_SIZE> processed;
+		processed.Push(m_root);
+		std::array<uint32_t, MAX_POINTS> found;
+
+		AggregateValue total{};
+		while (!processed.IsEmpty()) {
+			const auto current = processed.Pop();
+			if (area.Covers(current->m_box)) {
+				total = Aggregate::Combine(total, current->m_aggregate);
+				continue;
+			}
+
+			const size_t count = simd::FindInRect(current->m_xs.data(), current->m_ys.data(), current->m_size, area, found.data());
+			for (size_t k = 0; k < count; k++) {
+				const auto i = found[k];
+				total = Aggregate::Combine(total, Aggregate::Make(current->GetPoint(i), current->m_values[i]));
+			}
+			const unsigned quarters = current->IntersectQuarters(area);
+			for (size_t i = 0; i < Cardinals::COUNT; i++) {
+				if (current->m_children[i] && (quarters & (1u << i))) {
+					processed.Push(current->m_children[i]);
+				}
+			}
+		}
+		return total;
+	}
+
+	// return the closest neighbour point or nullopt if no points present
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::FindClosest(const Point& point) const -> std::optional<Point> {
+		if (auto closest = FindKClosest(point, 1); !closest.empty()) {
+			return closest.front();
+		}
+		return std::nullopt;
+	}
+
+	/**
+	 * Best-first search: nodes are ordered by the distance from the `point` to their box
+	 * which is a lower bound for any point stored in the subtree, so a point popped from the queue
+	 * is guaranteed to be closer than everything left in the queue.
+	 */
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::FindKClosest(const Point& point, size_t k) const -> std::vector<Point> {
+		std::vector<Point> closest;
+		if (k == 0 || IsEmpty()) {
+			return closest;
+		}
+		closest.reserve(std::min(k, m_size));
+
+		// either a node or a point (when `node` is nullptr)
+		struct Candidate {
+			SquareDistance_t<Coord> distance;
+			const Node* node;
+			Point point;
+		};
+		const auto isFarther = [](const Candidate& lhs, const Candidate& rhs) {
+			return lhs.distance > rhs.distance;
+		};
+		std::priority_queue<Candidate, std::vector<Candidate>, decltype(isFarther)> candidates{ isFarther };
+		candidates.push({ GetSquareDistance(m_root->m_box, point), m_root, {} });
+
+		while (!candidates.empty() && closest.size() < k) {
+			const auto current = candidates.top();
+			candidates.pop();
+
+			if (current.node == nullptr) {
+				closest.push_back(current.point);
+				continue;
+			}
+
+			for (size_t i = 0; i < current.node->m_size; i++) {
+				const auto data = current.node->GetPoint(i);
+				candidates.push({ GetSquareDistance(data, point), nullptr, data });
+			}
+
+			for (const auto& quarter : current.node->m_children) {
+				if (quarter) {
+					candidates.push({ GetSquareDistance(quarter->m_box, point), quarter, {} });
+				}
+			}
+		}
+
+		return closest;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::FindWithinRadius(const Point& point, Coord radius) const -> std::vector<Point> {
+		return GetPointsInCircle(point, radius);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetPointsInCircle(const Point& center, Coord radius) const -> std::vector<Point> {
+		std::vector<Point> points;
+		GetPointsInCircle(center, radius, std::back_inserter(points));
+		return points;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	template<class OutputIt>
+	OutputIt QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetPointsInCircle(
+		const Point& center, Coord radius, OutputIt out
+	) const {
+		if (radius < Coord(0)) {
+			return out;
+		}
+		const auto squareRadius = static_cast<SquareDistance_t<Coord>>(radius) * static_cast<SquareDistance_t<Coord>>(radius);
+		auto write = [&out](const Point& point, const Payload&, Handle) {
+			*out++ = point;
+		};
+
+		InlineStack<const Node*, INLINE_STACK_SIZE> processed;
+		processed.Push(m_root);
+		std::array<uint32_t, MAX_POINTS> found;
+
+		while (!processed.IsEmpty()) {
+			const auto current = processed.Pop();
+			// all of points of the subtree are in the circle
+			if (GetFarthestSquareDistance(current->m_box, center) <= squareRadius) {
+				ForEach(current, write);
+				continue;
+			}
+
+			const size_t count = simd::FindInCircle(
+				current->m_xs.data(), current->m_ys.data(), current->m_size, center, squareRadius, found.data()
+			);
+			for (size_t k = 0; k < count; k++) {
+				*out++ = current->GetPoint(found[k]);
+			}
+
+			// skip whole quarters which are too far away
+			for (const auto& quarter : current->m_children) {
+				if (quarter && GetSquareDistance(quarter->m_box, center) <= squareRadius) {
+					processed.Push(quarter);
+				}
+			}
+		}
+		return out;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetPointsInPolygon(
+		const Point* vertices, size_t count
+	) const -> std::vector<Point> {
+		std::vector<Point> points;
+		GetPointsInPolygon(vertices, count, std::back_inserter(points));
+		return points;
+	}
+
+	/**
+	 * The subtrees are traversed within the bounding box of the polygon. The box which isn't crossed
+	 * by the edges is either inside or outside of the polygon as a whole, like its middle.
+	 * Points of the boxes crossed by the edges are tested one by one.
+	 */
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	template<class OutputIt>
+	OutputIt QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetPointsInPolygon(
+		const Point* vertices, size_t count, OutputIt out
+	) const {
+		if (count < 3) {
+			return out;
+		}
+		Point min = vertices[0];
+		Point max = vertices[0];
+		for (size_t i = 1; i < count; i++) {
+			min = { std::min(min.x, vertices[i].x), std::min(min.y, vertices[i].y) };
+			max = { std::max(max.x, vertices[i].x), std::max(max.y, vertices[i].y) };
+		}
+		const Rect bounds{ min, { max.x - min.x, max.y - min.y } };
+		auto write = [&out](const Point& point, const Payload&, Handle) {
+			*out++ = point;
+		};
+
+		InlineStack<const Node*, INLINE_STACK_SIZE> processed;
+		processed.Push(m_root);
+
+		while (!processed.IsEmpty()) {
+			const auto current = processed.Pop();
+			const auto& box = current->m_box;
+			// the box around the polygon is crossed by its edges
+			const bool crossed = box.Covers(bounds) || std::any_of(vertices, vertices + count, [&](const Point& vertex) {
+				const auto next = &vertex + 1 == vertices + count ? vertices : &vertex + 1;
+				return detail::IsCrossing(vertex, *next, box);
+			});
+			if (!crossed) {
+				if (detail::IsInPolygon(box.GetMid(), vertices, count)) {
+					ForEach(current, write);
+				}
+				continue;
+			}
+
+			for (size_t i = 0; i < current->m_size; i++) {
+				const auto point = current->GetPoint(i);
+				const bool bounded = min.x <= point.x && point.x <= max.x && min.y <= point.y && point.y <= max.y;
+				if (bounded && detail::IsInPolygon(point, vertices, count)) {
+					*out++ = point;
+				}
+			}
+
+			// children's boxes are the quarters of the node's box
+			const unsigned quarters = current->IntersectQuarters(bounds);
+			for (size_t i = 0; i < Cardinals::COUNT; i++) {
+				if (current->m_children[i] && (quarters & (1u << i))) {
+					processed.Push(current->m_children[i]);
+				}
+			}
+		}
+		return out;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	Handle QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Insert(const Point& point, Payload value) {
+		// point is outside the boundary
+		if (!m_root->m_box.Contains(point)) {
+			return {};
+		}
+		const auto slot = AcquireSlot(point);
+		if (!Insert(m_root, point, value, slot, 0)) {
+			ReleaseSlot(slot);
+			return {};
+		}
+		m_size++;
+		Rebalance(point);
+		return MakeHandle(slot);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	bool QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Contains(const Point& point) const {
+		return Find(FindIndexed(point), point) != nullptr;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	bool QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Contains(Handle handle) const noexcept {
+		return handle.m_index < m_slots.size()
+			&& m_slots[handle.m_index].m_used
+			&& m_slots[handle.m_index].m_generation == handle.m_generation;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	const Payload* QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Find(const Point& point) const {
+		return Find(FindIndexed(point), point);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	Payload* QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Find(const Point& point) {
+		return const_cast<Payload*>(std::as_const(*this).Find(point));
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	const Payload* QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Find(Handle handle) const {
+		if (!Contains(handle)) {
+			return nullptr;
+		}
+		const Point& point = m_slots[handle.m_index].m_point;
+		return Find(FindIndexed(point), point);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	Payload* QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Find(Handle handle) {
+		return const_cast<Payload*>(std::as_const(*this).Find(handle));
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetPoint(Handle handle) const noexcept -> std::optional<Point> {
+		if (!Contains(handle)) {
+			return std::nullopt;
+		}
+		return m_slots[handle.m_index].m_point;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	bool QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Erase(const Point& point) {
+		const auto extracted = Erase(m_root, m_root, point);
+		if (!extracted) {
+			return false;
+		}
+		ReleaseSlot(extracted->handle);
+		m_size--;
+		return true;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	bool QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Erase(Handle handle) {
+		if (!Contains(handle)) {
+			return false;
+		}
+		// copy the point: the slot is released while erasing
+		const Point point = m_slots[handle.m_index].m_point;
+		return Erase(point);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	bool QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Move(const Point& from, const Point& to) {
+		if (from == to) {
+			return Contains(from);
+		}
+		// point is outside the boundary
+		if (!m_root->m_box.Contains(from) || !m_root->m_box.Contains(to)) {
+			return false;
+		}
+
+		// find the deepest node which subtree has both of positions
+		typename Node::pointer* common = &m_root;
+		size_t depth{ 0 };
+		while (true) {
+			const auto cardinal = (*common)->GetQuarter(from);
+			auto& child = (*common)->m_children[cardinal];
+			if (!child || cardinal != (*common)->GetQuarter(to)
+				|| !child->m_box.Contains(from) || !child->m_box.Contains(to)
+				|| (*common)->m_division == Division::NONE
+			) {
+				break;
+			}
+			common = &child;
+			depth++;
+		}
+		auto& node = *common;
+		if (Find(node, to) != nullptr) {
+			// the new position is taken
+			return false;
+		}
+
+		// the overflow leaf may keep any point of its box
+		const bool stays = node->m_division == Division::NONE || !node->m_children[node->GetQuarter(to)];
+		if (const auto index = node->Find(from); index < node->m_size && stays) {
+			// the point stays in this node
+			node->m_xs[index] = to.x;
+			node->m_ys[index] = to.y;
+			m_slots[node->m_handles[index]].m_point = to;
+			Summarize(*node);
+			SummarizeAncestors(node, from);
+			return true;
+		}
+
+		// don't let the common node be merged: the point is inserted back into it
+		auto extracted = Erase(node, node, from);
+		if (!extracted) {
+			return false;
+		}
+		if (Insert(node, to, extracted->value, extracted->handle, depth)) {
+			m_slots[extracted->handle].m_point = to;
+			SummarizeAncestors(node, from);
+			Rebalance(to);
+			return true;
+		}
+		// the new position is lost by rounding of the quarters' boundaries: put the point back
+		if (!Insert(node, from, extracted->value, extracted->handle, depth)) {
+			ReleaseSlot(extracted->handle);
+			m_size--;
+			// the subtree of the common node has already lost the point
+			for (auto ancestor = m_root; ancestor != node; ancestor = ancestor->m_children[ancestor->GetQuarter(from)]) {
+				ancestor->m_count--;
+			}
+			SummarizeAncestors(node, from);
+		}
+		return false;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	bool QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Move(Handle handle, const Point& to) {
+		if (!Contains(handle)) {
+			return false;
+		}
+		// copy the point: the slot is updated while moving
+		const Point from = m_slots[handle.m_index].m_point;
+		return Move(from, to);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	size_t QuadTree<Payload, Coord, LeafCapacity, Aggregate>::MoveMany(const std::vector<std::pair<Point, Point>>& moves) {
+		struct Order {
+			uint64_t code;
+			size_t move;
+		};
+		std::vector<Order> order;
+		order.reserve(moves.size());
+		for (size_t i = 0; i < moves.size(); i++) {
+			order.push_back({ GetMortonCode(moves[i].first, m_root->m_box), i });
+		}
+		RadixSort(order);
+
+		size_t moved{ 0 };
+		for (const auto& item : order) {
+			if (Move(moves[item.move].first, moves[item.move].second)) {
+				moved++;
+			}
+		}
+		return moved;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::PostOrderVisit(const Visitor_t& func) {
+		// apply func each node while traversing tree
+		PostOrderVisit(m_root, func);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::PreOrderVisit(const Visitor_t& func) {
+		// apply func each node while traversing tree
+		PreOrderVisit(m_root, func);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	size_t QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Build(
+		typename Node::pointer& node, Bucket* first, Bucket* last, size_t level, TaskGroup& group, std::mutex& poolMutex
+	) {
+		const auto quarterSize = static_cast<size_t>(last - first) / Cardinals::COUNT;
+		NodeBatch<Node> nodes{ m_pool, poolMutex };
+
+		size_t size{ 0 };
+		for (size_t i = 0; i < Cardinals::COUNT; i++) {
+			const auto quarterFirst = first + i * quarterSize;
+			const auto quarterLast = quarterFirst + quarterSize;
+
+			size_t count{ 0 };
+			for (auto bucket = quarterFirst; bucket != quarterLast; bucket++) {
+				count += static_cast<size_t>(bucket->last - bucket->first);
+			}
+			if (node->m_size + count <= MAX_POINTS) {
+				for (auto bucket = quarterFirst; bucket != quarterLast; bucket++) {
+					for (auto it = bucket->first; it != bucket->last; it++) {
+						Store(*node, *it);
+					}
+					bucket->size = 0;
+				}
+				size += count;
+				continue;
+			}
+
+			auto& child = node->m_children[i];
+			child = nodes.Acquire();
+			child->m_box = GetRect(static_cast<Cardinals>(i), node->m_box);
+			if (quarterSize == 1) {
+				group.Run([this, &child, bucket = quarterFirst, level, &poolMutex]() {
+					NodeBatch<Node> nodes{ m_pool, poolMutex };
+					bucket->size = Build(child, bucket->first, bucket->last, level + 1, nodes);
+				});
+			}
+			else {
+				size += Build(child, quarterFirst, quarterLast, level + 1, group, poolMutex);
+			}
+		}
+		return size;
+	}
+
+	/**
+	 * Points of each quarter form a contiguous range in Morton order.
+	 * Inserting them one by one the node keeps points of the quarter while it has room for all of them,
+	 * otherwise the quarter gets a child node which accomodates all of its points.
+	 */
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	size_t QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Build(
+		typename Node::pointer& node, MortonItem* first, MortonItem* last, size_t level, NodeBatch<Node>& nodes
+	) {
+		const Rect box = node->m_box;
+		if (!IsDivisible(box, level)) {
+			return BuildOverflow(node, first, last, nodes);
+		}
+		std::array<MortonItem*, Cardinals::COUNT + 1> bounds;
+		bounds.front() = first;
+		bounds.back() = last;
+		if (level < MORTON_LEVELS) {
+			for (size_t i = 1; i < Cardinals::COUNT; i++) {
+				bounds[i] = std::partition_point(bounds[i - 1], last, [level, i](const MortonItem& item) {
+					return GetQuarterAt(item.code, level) < i;
+				});
+			}
+		}
+		else {
+			// the code is exhausted: the range is small, so order it directly
+			std::stable_sort(first, last, [&box](const MortonItem& lhs, const MortonItem& rhs) {
+				return GetQuarter(lhs.point, box) < GetQuarter(rhs.point, box);
+			});
+			for (size_t i = 1; i < Cardinals::COUNT; i++) {
+				bounds[i] = std::partition_point(bounds[i - 1], last, [&box, i](const MortonItem& item) {
+					return GetQuarter(item.point, box) < i;
+				});
+			}
+		}
+
+		size_t size{ 0 };
+		for (size_t i = 0; i < Cardinals::COUNT; i++) {
+			const auto count = static_cast<size_t>(bounds[i + 1] - bounds[i]);
+			if (node->m_size + count <= MAX_POINTS) {
+				for (auto it = bounds[i]; it != bounds[i + 1]; it++) {
+					Store(*node, *it);
+				}
+				size += count;
+			}
+			else {
+				auto& child = node->m_children[i];
+				child = nodes.Acquire();
+				child->m_box = GetRect(static_cast<Cardinals>(i), box);
+				// like `Insert` skip points which are lost by rounding of the quarter's boundary
+				const auto contained = std::stable_partition(bounds[i], bounds[i + 1], [&child](const MortonItem& item) {
+					return child->m_box.Contains(item.point);
+				});
+				size += Build(child, bounds[i], contained, level + 1, nodes);
+			}
+		}
+		node->m_count = static_cast<uint32_t>(size);
+		Summarize(*node);
+		return size;
+	}
+
+	/**
+	 * Like `Build` the node keeps points of the quarter while it has room for all of them,
+	 * but the box is divided at the medians of all points of the subtree.
+	 */
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	size_t QuadTree<Payload, Coord, LeafCapacity, Aggregate>::BuildAtMedians(
+		typename Node::pointer& node, MortonItem* first, MortonItem* last, size_t level, NodeBatch<Node>& nodes
+	) {
+		if (static_cast<size_t>(last - first) <= MAX_POINTS - node->m_size) {
+			for (auto it = first; it != last; it++) {
+				Store(*node, *it);
+			}
+			node->m_count = node->m_size;
+			Summarize(*node);
+			return node->m_size;
+		}
+		if (!IsDivisible(node->m_box, level)) {
+			return BuildOverflow(node, first, last, nodes);
+		}
+
+		const Point center{
+			detail::GetMedian(first, last, [](const MortonItem& item) { return item.point.x; }),
+			detail::GetMedian(first, last, [](const MortonItem& item) { return item.point.y; })
+		};
+		node->m_center = center;
+		node->m_division = Division::CENTER;
+		// the center leaving all of points in one quarter doesn't separate them
+		const auto quarter = GetQuarter(first->point, center);
+		if (std::all_of(first, last, [&center, quarter](const MortonItem& item) { return GetQuarter(item.point, center) == quarter; })
+			|| !IsCovered(node->m_box, Division::CENTER, center)
+		) {
+			node->m_division = Division::MIDDLE;
+		}
+
+		// group the points by quarters: the northern ones first, then the western ones in each half
+		const auto quarterOf = [node](const MortonItem& item) {
+			return node->GetQuarter(item.point);
+		};
+		std::array<MortonItem*, Cardinals::COUNT + 1> bounds;
+		bounds[0] = first;
+		bounds[2] = std::partition(first, last, [&quarterOf](const MortonItem& item) { return quarterOf(item) < Cardinals::SW; });
+		bounds[1] = std::partition(first, bounds[2], [&quarterOf](const MortonItem& item) { return quarterOf(item) == Cardinals::NW; });
+		bounds[3] = std::partition(bounds[2], last, [&quarterOf](const MortonItem& item) { return quarterOf(item) == Cardinals::SW; });
+		bounds[4] = last;
+
+		size_t size{ 0 };
+		for (size_t i = 0; i < Cardinals::COUNT; i++) {
+			const auto count = static_cast<size_t>(bounds[i + 1] - bounds[i]);
+			if (node->m_size + count <= MAX_POINTS) {
+				for (auto it = bounds[i]; it != bounds[i + 1]; it++) {
+					Store(*node, *it);
+				}
+				size += count;
+			}
+			else {
+				auto& child = node->m_children[i];
+				child = nodes.Acquire();
+				child->m_box = node->GetQuarterBox(static_cast<Cardinals>(i));
+				// like `Insert` skip points which are lost by rounding of the quarter's boundary
+				const auto contained = std::stable_partition(bounds[i], bounds[i + 1], [&child](const MortonItem& item) {
+					return child->m_box.Contains(item.point);
+				});
+				size += BuildAtMedians(child, bounds[i], contained, level + 1, nodes);
+			}
+		}
+		node->m_count = static_cast<uint32_t>(size);
+		node->m_built = node->m_count;
+		Summarize(*node);
+		return size;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	size_t QuadTree<Payload, Coord, LeafCapacity, Aggregate>::BuildOverflow(
+		typename Node::pointer& node, MortonItem* first, MortonItem* last, NodeBatch<Node>& nodes
+	) {
+		// each leaf of the chain is filled before the next one is created, as if the points are inserted in order
+		std::vector<Node*> chain{ node };
+		for (auto it = first; ; ) {
+			Node& current = *chain.back();
+			const auto kept = it + std::min(static_cast<size_t>(last - it), MAX_POINTS - current.m_size);
+			for (; it != kept; it++) {
+				Store(current, *it);
+			}
+			if (it == last) {
+				break;
+			}
+			current.m_division = Division::NONE;
+			auto& child = current.m_children[Cardinals::NW];
+			child = nodes.Acquire();
+			child->m_box = current.m_box;
+			chain.push_back(child);
+		}
+		// the counts and statistics of the chain are collected from its end
+		size_t size{ 0 };
+		for (auto it = chain.rbegin(); it != chain.rend(); it++) {
+			size += (*it)->m_size;
+			(*it)->m_count = static_cast<uint32_t>(size);
+			Summarize(**it);
+		}
+		return size;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	size_t QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Recount(Node* node, size_t depth, size_t levels) {
+		if (depth == levels) {
+			return node->m_count;
+		}
+		size_t count = node->m_size;
+		for (const auto child : node->m_children) {
+			if (child) {
+				count += Recount(child, depth + 1, levels);
+			}
+		}
+		node->m_count = static_cast<uint32_t>(count);
+		Summarize(*node);
+		return count;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Summarize(Node& node) const {
+		if constexpr (HAS_AGGREGATE) {
+			AggregateValue aggregate{};
+			for (size_t i = 0; i < node.m_size; i++) {
+				aggregate = Aggregate::Combine(aggregate, Aggregate::Make(node.GetPoint(i), node.m_values[i]));
+			}
+			for (const auto child : node.m_children) {
+				if (child) {
+					aggregate = Aggregate::Combine(aggregate, child->m_aggregate);
+				}
+			}
+			node.m_aggregate = aggregate;
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::SummarizeAncestors(const Node* node, const Point& point) const {
+		if constexpr (HAS_AGGREGATE) {
+			InlineStack<Node*, INLINE_STACK_SIZE> ancestors;
+			for (auto ancestor = m_root; ancestor != node; ancestor = ancestor->m_children[ancestor->GetQuarter(point)]) {
+				ancestors.Push(ancestor);
+			}
+			while (!ancestors.IsEmpty()) {
+				Summarize(*ancestors.Pop());
+			}
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Accumulate(
+		Node& node, const Point& point, const Payload& value
+	) const {
+		if constexpr (HAS_AGGREGATE) {
+			node.m_aggregate = Aggregate::Combine(node.m_aggregate, Aggregate::Make(point, value));
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Store(Node& node, MortonItem& item) {
+		// slots of different points are touched by the tasks of parallel build independently
+		m_slots[item.handle].m_point = item.point;
+		m_slots[item.handle].m_used = true;
+		node.Push(item.point, std::move(item.value), item.handle);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::ResetSlots(size_t count) {
+		assert(IsEmpty() && "Slots are in use");
+		assert(count < Handle::NONE && "Run out of handles");
+		if (m_slots.size() < count) {
+			Slot slot;
+			slot.m_generation = m_firstGeneration;
+			m_slots.resize(count, slot);
+		}
+		m_freeSlots.clear();
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::CollectFreeSlots() {
+		m_freeSlots.clear();
+		// the first slots are taken first
+		for (size_t i = m_slots.size(); i-- > 0; ) {
+			if (!m_slots[i].m_used) {
+				m_freeSlots.push_back(static_cast<uint32_t>(i));
+			}
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	uint32_t QuadTree<Payload, Coord, LeafCapacity, Aggregate>::AcquireSlot(const Point& point) {
+		uint32_t slot;
+		if (!m_freeSlots.empty()) {
+			slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else {
+			assert(m_slots.size() < Handle::NONE && "Run out of handles");
+			slot = static_cast<uint32_t>(m_slots.size());
+			m_slots.emplace_back();
+			m_slots.back().m_generation = m_firstGeneration;
+		}
+		m_slots[slot].m_point = point;
+		m_slots[slot].m_used = true;
+		return slot;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::ReleaseSlot(uint32_t slot) {
+		m_slots[slot].m_used = false;
+		m_maxGeneration = std::max(m_maxGeneration, ++m_slots[slot].m_generation);
+		m_freeSlots.push_back(slot);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	Handle QuadTree<Payload, Coord, LeafCapacity, Aggregate>::MakeHandle(uint32_t slot) const noexcept {
+		Handle handle;
+		handle.m_index = slot;
+		handle.m_generation = m_slots[slot].m_generation;
+		return handle;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Release(typename Node::pointer node) noexcept {
+		InlineStack<Node*, INLINE_STACK_SIZE> pending;
+		pending.Push(node);
+		while (!pending.IsEmpty()) {
+			const auto current = pending.Pop();
+			for (auto child : current->m_children) {
+				if (child) {
+					pending.Push(child);
+				}
+			}
+			if (current->m_code != 0) {
+				m_index.Erase(current->m_code);
+			}
+			m_pool.Release(current);
+		}
+	}
+
+	/**
+	 * The links to the nodes on the way to the point are collected first,
+	 * then the nodes are restored from the one which had the point up to the `node`.
+	 */
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Erase(
+		typename Node::pointer& node, typename Node::pointer& parent, const Point& point
+	) -> std::optional<Extracted> {
+		InlineStack<typename Node::pointer*, INLINE_STACK_SIZE> path;
+		typename Node::pointer* link = &node;
+		while (true) {
+			// point is outside the boundary
+			if (!(*link)->m_box.Contains(point)) {
+				return std::nullopt;
+			}
+			// find a needed quarter
+			auto& child = (*link)->m_children[(*link)->GetQuarter(point)];
+			if (child == nullptr || (*link)->KeepsOverflow(point)) {
+				break;
+			}
+			path.Push(link);
+			link = &child;
+		}
+
+		auto& target = *link;
+		const auto index = target->Find(point);
+		if (index == target->m_size) {
+			return std::nullopt;
+		}
+		// remove point from the node
+		std::optional<Extracted> extracted = Extracted{ std::move(target->m_values[index]), target->m_handles[index] };
+		target->Remove(index);
+		target->m_count--;
+		Summarize(*target);
+
+		typename Node::pointer* above = path.IsEmpty() ? &parent : path.Pop();
+		if (auto isLeaf = target->IsLeaf(); isLeaf && target != *above) {
+			Merge(target, *above);
+		}
+		else if (!isLeaf) {
+			// try to find child which is leaf and data from which can extracted to this node
+			for (auto& child : target->m_children) {
+				if (child && child->IsLeaf()) {
+					Merge(child, target);
+				}
+			}
+		}
+
+		// restore properties of the tree on the way up: `above` is the link to the parent of the node at `link`
+		while (link != &node) {
+			const auto grand = path.IsEmpty() ? &parent : path.Pop();
+			auto& current = *above;
+			auto& child = *link;
+			current->m_count--;
+			Summarize(*current);
+			if (!child && *grand != current && current->IsLeaf()) {
+				// child was removed and now this node is a leaf
+				// so we can try to merge it with parent (maybe points can be transfered to parent node)
+				// and this node will be useless too.
+				Merge(current, *grand);
+			}
+			else if (child && child->IsLeaf()) {
+				// target node (from which we remove the point) wasn't leaf before and now it is
+				// so we can try to merge it with parent (maybe points can be transfered to parent node)
+				// and this node will be useless too.
+				Merge(child, current);
+			}
+			link = above;
+			above = grand;
+		}
+		return extracted;
+	}
+
+	// apply func each node while traversing tree
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::PostOrderVisit(typename Node::pointer& node, const Visitor_t& func) {
+		InlineStack<VisitFrame, INLINE_STACK_SIZE> frames;
+		frames.Push({ &node, 0 });
+		while (!frames.IsEmpty()) {
+			auto frame = frames.Pop();
+			auto& children = (*frame.node)->m_children;
+			while (frame.next < Cardinals::COUNT && children[frame.next] == nullptr) {
+				frame.next++;
+			}
+			if (frame.next < Cardinals::COUNT) {
+				// come back to the node after the child
+				frames.Push({ frame.node, frame.next + 1 });
+				frames.Push({ &children[frame.next], 0 });
+			}
+			else {
+				std::invoke(func, *frame.node);
+			}
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::PreOrderVisit(typename Node::pointer& node, const Visitor_t& func) {
+		InlineStack<VisitFrame, INLINE_STACK_SIZE> frames;
+		frames.Push({ &node, 0 });
+		while (!frames.IsEmpty()) {
+			auto frame = frames.Pop();
+			auto& children = (*frame.node)->m_children;
+			while (frame.next < Cardinals::COUNT && children[frame.next] == nullptr) {
+				frame.next++;
+			}
+			if (frame.next < Cardinals::COUNT) {
+				frames.Push({ frame.node, frame.next + 1 });
+				std::invoke(func, *frame.node);
+				frames.Push({ &children[frame.next], 0 });
+			}
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetPointsAt(
+		const Node* node, const Rect* areas, std::vector<uint32_t>& active, size_t first, size_t last,
+		std::vector<BatchHit>& hits
+	) const {
+		const auto scan = [areas, &active, &hits](const Node* current, size_t from, size_t to) {
+			std::array<uint32_t, MAX_POINTS> found;
+			for (size_t k = from; current->m_size > 0 && k < to; k++) {
+				const size_t count = simd::FindInRect(
+					current->m_xs.data(), current->m_ys.data(), current->m_size, areas[active[k]], found.data()
+				);
+				for (size_t i = 0; i < count; i++) {
+					hits.push_back({ active[k], current->GetPoint(found[i]) });
+				}
+			}
+		};
+
+		InlineStack<BatchFrame, INLINE_STACK_SIZE> frames;
+		scan(node, first, last);
+		frames.Push({ node, first, last, 0 });
+		while (!frames.IsEmpty()) {
+			auto frame = frames.Pop();
+			// the areas of the child are appended to the list and dropped after the child is done
+			const size_t begin = active.size();
+			const Node* quarter{ nullptr };
+			for (; frame.next < Cardinals::COUNT && !quarter; frame.next++) {
+				const auto child = frame.node->m_children[frame.next];
+				if (!child) {
+					continue;
+				}
+				for (size_t k = frame.first; k < frame.last; k++) {
+					if (areas[active[k]].Intersect(child->m_box)) {
+						active.push_back(active[k]);
+					}
+				}
+				if (active.size() > begin) {
+					quarter = child;
+				}
+			}
+			if (quarter) {
+				frames.Push(frame);
+				scan(quarter, begin, active.size());
+				frames.Push({ quarter, begin, active.size(), 0 });
+			}
+			else if (!frames.IsEmpty()) {
+				active.resize(frame.first);
+			}
+		}
+	}
+
+	// Find the point in the node
+	// return nullptr if it doesn't exist
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	const Payload* QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Find(const Node* node, const Point& point) const noexcept {
+		for (const Node* current = node; ; ) {
+			// point is outside the boundary
+			if (!current->m_box.Contains(point)) {
+				return nullptr;
+			}
+
+			// find a needed quarter
+			if (const auto child = current->m_children[current->GetQuarter(point)]; child != nullptr && !current->KeepsOverflow(point)) {
+				current = child;
+			}
+			else if (const auto index = current->Find(point); index < current->m_size) {
+				// point is in this node
+				return &current->m_values[index];
+			}
+			else {
+				return nullptr;
+			}
+		}
+	}
+
+	/**
+	 * The ancestors of the indexed node are indexed, so the indexed cells on the way to the point
+	 * are the shallower ones and the deepest of them is found by binary search checking O(log depth) codes.
+	 * The box of the indexed node is inside the boxes of its ancestors and the quarters don't overlap,
+	 * so the indexed node which has the point is on the way to it whatever code led to it.
+	 */
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::FindIndexed(const Point& point) const noexcept -> Node* {
+		if (m_index.IsEmpty()) {
+			return m_root;
+		}
+		const uint64_t code = GetCellCode(point, m_root->m_box);
+		Node* found = m_root;
+		size_t low{ 0 };
+		size_t high = m_index.GetDepth();
+		while (low < high) {
+			const size_t middle = (low + high + 1) / 2;
+			if (const auto node = m_index.Find(code >> (2 * (MAX_CODE_DEPTH - middle))); node != nullptr) {
+				found = node;
+				low = middle;
+			}
+			else {
+				high = middle - 1;
+			}
+		}
+		// the point within rounding error of the boundary of the cell may be outside it
+		return found->m_box.Contains(point) ? found : m_root;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Index(Node& node, uint64_t code) {
+		node.m_code = code;
+		if (code != 0) {
+			m_index.Insert(code, &node);
+		}
+		InlineStack<Node*, INLINE_STACK_SIZE> pending;
+		pending.Push(&node);
+		while (!pending.IsEmpty()) {
+			const auto current = pending.Pop();
+			for (size_t i = 0; i < Cardinals::COUNT; i++) {
+				if (const auto child = current->m_children[i]; child != nullptr) {
+					IndexChild(*current, static_cast<Cardinals>(i), *child);
+					pending.Push(child);
+				}
+			}
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::IndexChild(const Node& parent, Cardinals cardinal, Node& child) {
+		// the parent's code is shorter than the deepest one
+		const bool indexed = parent.m_code != 0 && (parent.m_code >> (2 * MAX_CODE_DEPTH)) == 0;
+		// the quarter stretched out of the parent's box by rounding would overlap its neighbours
+		const bool regular = parent.m_division == Division::MIDDLE && parent.m_box.Covers(child.m_box);
+		child.m_code = indexed && regular ? GetChildCode(parent.m_code, cardinal) : 0;
+		if (child.m_code != 0) {
+			m_index.Insert(child.m_code, &child);
+		}
+	}
+
+	// Insert `point` into the `node`, the counts and statistics of the nodes on the way are updated once it's stored
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Insert(
+		const typename Node::pointer& node, const Point& point, Payload& value, uint32_t handle, size_t depth
+	) -> const Payload* {
+		InlineStack<Node*, INLINE_STACK_SIZE> path;
+		Node* current = node;
+		for (; ; depth++) {
+			// point is outside the boundary
+			if (!current->m_box.Contains(point)) {
+				return nullptr;
+			}
+			path.Push(current);
+
+			// find a needed quarter
+			if (auto& child = current->m_children[current->GetQuarter(point)]; child != nullptr) {
+				if (current->KeepsOverflow(point)) { // point already exist in the tree
+					return nullptr;
+				}
+				current = child;
+			}
+			else if (current->Find(point) < current->m_size) { // point already exist in the tree
+				return nullptr;
+			}
+			else if (current->m_size < MAX_POINTS) { // see if the node still can accomodate any point
+				current->Push(point, std::move(value), handle);
+				break;
+			}
+			else {
+				if (current->IsLeaf()) {
+					Divide(*current, point, depth);
+				}
+				const auto cardinal = current->GetQuarter(point);
+				auto& quarter = current->m_children[cardinal];
+				quarter = m_pool.Acquire();
+				quarter->m_box = current->GetQuarterBox(cardinal);
+				IndexChild(*current, cardinal, *quarter);
+
+				// move points which have same quarter to this child node, the overflow leaf keeps its points
+				for (size_t i = 0; current->m_division != Division::NONE && i < current->m_size; ) {
+					if (quarter->m_box.Contains(current->GetPoint(i))) {
+						quarter->Push(current->GetPoint(i), std::move(current->m_values[i]), current->m_handles[i]);
+						current->Remove(i);
+					}
+					else {
+						i++;
+					}
+				}
+				quarter->m_count = quarter->m_size;
+				Summarize(*quarter);
+				current = quarter;
+			}
+		}
+
+		const auto stored = &current->m_values[current->m_size - 1];
+		while (!path.IsEmpty()) {
+			const auto ancestor = path.Pop();
+			ancestor->m_count++;
+			Accumulate(*ancestor, point, *stored);
+		}
+		return stored;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	bool QuadTree<Payload, Coord, LeafCapacity, Aggregate>::IsDivisible(const Rect& box, size_t depth) const noexcept {
+		return depth < m_maxDepth && tree::IsDivisible(box, m_minCellSize);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Divide(Node& node, const Point& point, size_t depth) const {
+		if (!IsDivisible(node.m_box, depth)) {
+			node.m_division = Division::NONE;
+			return;
+		}
+		node.m_division = Division::MIDDLE;
+		if (m_splitPolicy != SplitPolicy::MEDIAN) {
+			return;
+		}
+
+		std::array<Point, MAX_POINTS + 1> points;
+		for (size_t i = 0; i < node.m_size; i++) {
+			points[i] = node.GetPoint(i);
+		}
+		points[node.m_size] = point;
+		const auto first = points.begin();
+		const auto last = first + node.m_size + 1;
+		const Point center{
+			detail::GetMedian(first, last, [](const Point& item) { return item.x; }),
+			detail::GetMedian(first, last, [](const Point& item) { return item.y; })
+		};
+		// the center leaving all of points in one quarter doesn't separate them
+		const auto cardinal = GetQuarter(point, center);
+		const bool separates = std::any_of(first, last, [&center, cardinal](const Point& item) {
+			return GetQuarter(item, center) != cardinal;
+		});
+		if (separates && IsCovered(node.m_box, Division::CENTER, center)) {
+			node.m_center = center;
+			node.m_division = Division::CENTER;
+		}
+	}
+
+	/**
+	 * The subtree is unbalanced when one quarter has more than 3/4 of its points, like in scapegoat trees
+	 * rebuilding it costs O(n) which is paid by the insertions into it since it was built.
+	 * The subtree which points can't be separated better (e.g. they are on one line) is rebuilt again
+	 * only when it has twice as many points.
+	 */
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Rebalance(const Point& point) {
+		if (m_splitPolicy != SplitPolicy::MEDIAN) {
+			return;
+		}
+		typename Node::pointer* node = &m_root;
+		for (size_t depth = 0; (*node)->m_division != Division::NONE; depth++) {
+			auto& child = (*node)->m_children[(*node)->GetQuarter(point)];
+			if (!child) {
+				return;
+			}
+			const size_t count = (*node)->m_count;
+			if (count >= MIN_REBUILT && count >= 2 * size_t{ (*node)->m_built } && 4 * size_t{ child->m_count } > 3 * count) {
+				Rebuild(*node, depth);
+				return;
+			}
+			node = &child;
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Rebuild(typename Node::pointer& node, size_t depth) {
+		std::vector<MortonItem> items;
+		items.reserve(node->m_count);
+		InlineStack<Node*, INLINE_STACK_SIZE> pending;
+		pending.Push(node);
+		while (!pending.IsEmpty()) {
+			const auto current = pending.Pop();
+			for (size_t i = 0; i < current->m_size; i++) {
+				items.push_back({ 0, current->GetPoint(i), current->m_values[i], current->m_handles[i] });
+			}
+			for (const auto child : current->m_children) {
+				if (child) {
+					pending.Push(child);
+				}
+			}
+		}
+
+		std::mutex poolMutex;
+		NodeBatch<Node> nodes{ m_pool, poolMutex };
+		auto rebuilt = nodes.Acquire();
+		rebuilt->m_box = node->m_box;
+		if (BuildAtMedians(rebuilt, items.data(), items.data() + items.size(), depth, nodes) == items.size()) {
+			const auto code = node->m_code;
+			Release(node);
+			node = rebuilt;
+			Index(*node, code);
+		}
+		else {
+			// the new boundaries lose some points by rounding: keep the old subtree
+			Release(rebuilt);
+			node->m_built = node->m_count;
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Merge(typename Node::pointer& child, typename Node::pointer& parent) {
+		if (m_mergePolicy != MergePolicy::DEFERRED) {
+			const auto code = child->m_code;
+			detail::TryMerge(child, parent, m_pool, m_mergeLimit);
+			if (!child && code != 0) {
+				m_index.Erase(code);
+			}
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::SetMergePolicy(MergePolicy policy, size_t lowWater) noexcept {
+		m_mergePolicy = policy;
+		m_mergeLimit = policy == MergePolicy::LOW_WATER ? std::min(lowWater, MAX_POINTS) : MAX_POINTS;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	MergePolicy QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetMergePolicy() const noexcept {
+		return m_mergePolicy;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::SetSplitPolicy(SplitPolicy policy, size_t maxDepth) noexcept {
+		m_splitPolicy = policy;
+		m_maxDepth = maxDepth;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	SplitPolicy QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetSplitPolicy() const noexcept {
+		return m_splitPolicy;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	size_t QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetMaxDepth() const noexcept {
+		return m_maxDepth;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::SetMinCellSize(Coord size) noexcept {
+		m_minCellSize = size;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	Coord QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetMinCellSize() const noexcept {
+		return m_minCellSize;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::SetLocationIndex(bool enabled) {
+		m_indexed = enabled;
+		m_index.Clear();
+		// the nodes lose their codes when the index is dropped
+		Index(*m_root, enabled ? ROOT_CODE : 0);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	bool QuadTree<Payload, Coord, LeafCapacity, Aggregate>::HasLocationIndex() const noexcept {
+		return m_indexed;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Locate(const Point& point) const noexcept -> const Node* {
+		if (!m_root->m_box.Contains(point)) {
+			return nullptr;
+		}
+		for (const Node* current = FindIndexed(point); ; ) {
+			const auto child = current->m_children[current->GetQuarter(point)];
+			if (!child || current->KeepsOverflow(point) || !child->m_box.Contains(point)) {
+				return current;
+			}
+			current = child;
+		}
+	}
+
+	/**
+	 * The cells covering the neighbouring cell are its prefixes, like for `FindIndexed`
+	 * the indexed ones are the shallower ones, so the deepest of them is found by binary search.
+	 */
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	auto QuadTree<Payload, Coord, LeafCapacity, Aggregate>::FindNeighbour(const Node& node, Side side) const noexcept -> const Node* {
+		if (node.m_code == 0) {
+			return nullptr;
+		}
+		const auto code = GetNeighbourCode(node.m_code, side);
+		if (code == 0) {
+			return nullptr;
+		}
+		// the root is indexed
+		const Node* found = m_root;
+		const size_t depth = GetCodeDepth(code);
+		size_t low{ 0 };
+		size_t high = depth;
+		while (low < high) {
+			const size_t middle = (low + high + 1) / 2;
+			if (const auto cover = m_index.Find(code >> (2 * (depth - middle))); cover != nullptr) {
+				found = cover;
+				low = middle;
+			}
+			else {
+				high = middle - 1;
+			}
+		}
+		return found;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Compact() {
+		Compact(m_root, m_root);
+	}
+
+	// merge the children first, so the node may become a leaf and be merged too
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	void QuadTree<Payload, Coord, LeafCapacity, Aggregate>::Compact(typename Node::pointer& node, typename Node::pointer& parent) {
+		// the frame of the child follows the frame of its parent
+		InlineStack<VisitFrame, INLINE_STACK_SIZE> frames;
+		frames.Push({ &node, 0 });
+		while (!frames.IsEmpty()) {
+			auto frame = frames.Pop();
+			auto& children = (*frame.node)->m_children;
+			while (frame.next < Cardinals::COUNT && children[frame.next] == nullptr) {
+				frame.next++;
+			}
+			if (frame.next < Cardinals::COUNT) {
+				frames.Push({ frame.node, frame.next + 1 });
+				frames.Push({ &children[frame.next], 0 });
+				continue;
+			}
+			auto& current = *frame.node;
+			const auto code = current->m_code;
+			if (frame.node != &node && current->IsLeaf()) {
+				// the parent's frame is under this one
+				auto upper = frames.Pop();
+				detail::TryMerge(current, *upper.node, m_pool);
+				frames.Push(upper);
+			}
+			else if (frame.node == &node && node != parent && node->IsLeaf()) {
+				detail::TryMerge(node, parent, m_pool);
+			}
+			if (!current && code != 0) {
+				m_index.Erase(code);
+			}
+		}
+	}
 
-	inline bool QuadTree::IsEmpty() const noexcept {
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	bool QuadTree<Payload, Coord, LeafCapacity, Aggregate>::IsEmpty() const noexcept {
 		return m_size == 0;
 	}
 
-	inline size_t QuadTree::GetSize() const noexcept {
+	template<class Payload, class Coord, size_t LeafCapacity, class Aggregate>
+	size_t QuadTree<Payload, Coord, LeafCapacity, Aggregate>::GetSize() const noexcept {
 		return m_size;
 	}
 
-} // namespace tree
\ No newline at end of file
+} // namespace tree
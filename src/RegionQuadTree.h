@@ -0,0 +1,608 @@
+#pragma once
+
+#include "healthy.h"
+#include "Cardinals.h"
+#include "InlineStack.h"
+#include "QuadTree.h"
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace tree {
+
+	/**
+	 * Quad tree of rectangles (e.g. bounding boxes of objects for the broad phase of collision detection).
+	 *
+	 * An item is kept by the smallest node which box encloses it: items crossing the boundaries
+	 * of the quarters stay in the parent. A leaf is split into four quarters (see GetRect) once it has
+	 * more than `LeafCapacity` items, so only the items fitting a quarter move down.
+	 * Leaves are merged back when their parent's subtree has no more than `LeafCapacity` items.
+	 * Items outside the boundary are kept by the root.
+	 *
+	 * Nodes are kept in one array, four children of a node are allocated together
+	 * and items of a node form an intrusive list, so moving items don't allocate once the buffers have grown.
+	 * Rectangles overlap when they intersect or touch (see mt::BasicRect::Intersect).
+	 *
+	 * @tparam Payload the value stored with each item
+	 * @tparam Coord the type of coordinates
+	 * @tparam LeafCapacity number of items a leaf keeps before it's split
+	 */
+	template<class Payload = NoPayload, class Coord = float, size_t LeafCapacity = 8>
+	class RegionQuadTree {
+	public:
+		using Index = uint32_t;
+		using Point = mt::BasicPt<Coord>;
+		using Rect = mt::BasicRect<Coord>;
+
+		static constexpr Index NONE{ std::numeric_limits<Index>::max() };
+		static constexpr size_t MAX_ITEMS{ LeafCapacity };
+		// leaves at this depth aren't split: items with the same boxes can't be separated anyway
+		static constexpr size_t MAX_DEPTH{ 16 };
+
+		struct Node {
+			Rect m_box;
+			// children are [m_firstChild, m_firstChild + Cardinals::COUNT) or NONE for the leaf
+			Index m_firstChild{ NONE };
+			Index m_parent{ NONE };
+			// the first of own items
+			Index m_head{ NONE };
+			// number of own items and of the items of the subtree
+			uint32_t m_size{ 0 };
+			uint32_t m_count{ 0 };
+			uint32_t m_depth{ 0 };
+
+			bool IsLeaf() const noexcept {
+				return m_firstChild == NONE;
+			}
+		};
+
+		explicit RegionQuadTree(const Rect& fullArea);
+
+		/**
+		 * Insert the rectangle with the value.
+		 * Return handle of the item which stays valid until the item is erased.
+		 */
+		Handle Insert(const Rect& box, Payload value = {});
+
+		// erase the item referred by the handle, return whether it was in the tree
+		bool Erase(Handle handle);
+
+		/**
+		 * Change the rectangle of the item.
+		 * The item which stays in its node is updated in place, otherwise it is reinserted.
+		 */
+		bool Move(Handle handle, const Rect& box);
+
+		// check whether the handle refers to the item which is still in the tree
+		bool Contains(Handle handle) const noexcept;
+
+		// return the rectangle of the item or nullopt if the item was erased
+		std::optional<Rect> GetBox(Handle handle) const noexcept;
+
+		// return the value of the item or nullptr if the item was erased
+		const Payload* Find(Handle handle) const noexcept;
+
+		Payload* Find(Handle handle) noexcept;
+
+		/**
+		 * Call `visitor(box, value, handle)` for each item overlapping the area.
+		 * The visitor may return false to stop the traversal early.
+		 * Return false if the traversal was stopped by the visitor.
+		 */
+		template<class Visitor>
+		bool ForEachAt(const Rect& area, Visitor&& visitor) const;
+
+		// return handles of the items overlapping the area
+		std::vector<Handle> GetItemsAt(const Rect& area) const;
+
+		/**
+		 * Call `visitor(first, second)` once for each pair of overlapping items.
+		 * An item is tested against the items of its node and against the items of its ancestors
+		 * which overlap the node, so the items far from each other are never compared.
+		 * The visitor may return false to stop early. Return false if it was stopped by the visitor.
+		 */
+		template<class Visitor>
+		bool ForEachOverlappingPair(Visitor&& visitor) const;
+
+		// apply func to each node while traversing tree (parents before children)
+		template<class Visitor>
+		void PreOrderVisit(Visitor&& visitor) const;
+
+		bool IsEmpty() const noexcept;
+
+		// return number of items in the tree
+		size_t GetSize() const noexcept;
+
+		// return number of allocated (used or recycled) nodes
+		size_t GetCapacity() const noexcept;
+
+		// remove all of items invalidating their handles, memory is kept for reuse
+		void Clear();
+
+	private:
+		struct Item {
+			Rect m_box;
+			Payload m_value;
+			// the node keeping the item and the neighbours in its list
+			Index m_node{ NONE };
+			Index m_prev{ NONE };
+			Index m_next{ NONE };
+			// incremented each time the slot is released so old handles don't match
+			uint32_t m_generation{ 0 };
+			bool m_used{ false };
+		};
+
+		static constexpr Index ROOT{ 0 };
+
+		Handle MakeHandle(Index item) const noexcept;
+
+		// return the index of the item referred by the handle or NONE
+		Index GetItem(Handle handle) const noexcept;
+
+		// return the child of the node which box encloses the rectangle or NONE
+		Index FindChild(Index node, const Rect& box) const noexcept;
+
+		// put the item to the smallest node enclosing it splitting the leaf when it overflows
+		void Place(Index item);
+
+		// add the item to the list of the node
+		void Link(Index item, Index node) noexcept;
+
+		// remove the item from the list of its node and from the counts of the node's ancestors
+		void Unlink(Index item) noexcept;
+
+		// split the leaf moving the items fitting the quarters to the children
+		void Split(Index node);
+
+		// merge the subtrees of the node and its ancestors which items fit one leaf
+		void TryMerge(Index node);
+
+		// return index of the first node of the block of four nodes
+		Index AllocateChildren();
+
+		// the item tested by ForEachOverlappingPair, bounds are copied so the tests read them sequentially
+		struct Candidate {
+			Coord m_left;
+			Coord m_top;
+			Coord m_right;
+			Coord m_bottom;
+			Index m_item;
+
+			Candidate(const Rect& box, Index item) noexcept
+				: m_left{ box.origin.x }
+				, m_top{ box.origin.y }
+				, m_right{ box.GetMaxX() }
+				, m_bottom{ box.GetMaxY() }
+				, m_item{ item }
+			{}
+
+			// same as Rect::Intersect without branches: the outcome of the test is hard to predict
+			bool Intersect(const Candidate& other) const noexcept {
+				return (m_left <= other.m_right) & (other.m_left <= m_right)
+					& (m_top <= other.m_bottom) & (other.m_top <= m_bottom);
+			}
+		};
+
+		template<class Visitor>
+		bool ForEachOverlappingPair(Index node, std::vector<Candidate>& active, size_t first, Visitor& visitor) const;
+
+	private:
+		std::vector<Node> m_nodes;
+		std::vector<Item> m_items;
+		// released blocks of nodes and slots of items which can be reused
+		std::vector<Index> m_freeNodes;
+		std::vector<Index> m_freeItems;
+		// slots created after `Clear` start from this generation, so handles issued before it don't match them
+		uint32_t m_firstGeneration{ 0 };
+		// no handle has greater generation
+		uint32_t m_maxGeneration{ 0 };
+	};
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	RegionQuadTree<Payload, Coord, LeafCapacity>::RegionQuadTree(const Rect& fullArea) {
+		m_nodes.push_back(Node{ fullArea });
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	Handle RegionQuadTree<Payload, Coord, LeafCapacity>::Insert(const Rect& box, Payload value) {
+		Index item;
+		if (!m_freeItems.empty()) {
+			item = m_freeItems.back();
+			m_freeItems.pop_back();
+		}
+		else {
+			item = static_cast<Index>(m_items.size());
+			m_items.push_back(Item{ box, Payload{} });
+			m_items.back().m_generation = m_firstGeneration;
+		}
+		auto& slot = m_items[item];
+		slot.m_box = box;
+		slot.m_value = std::move(value);
+		slot.m_used = true;
+		Place(item);
+		return MakeHandle(item);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool RegionQuadTree<Payload, Coord, LeafCapacity>::Erase(Handle handle) {
+		const auto item = GetItem(handle);
+		if (item == NONE) {
+			return false;
+		}
+		const auto node = m_items[item].m_node;
+		Unlink(item);
+		auto& slot = m_items[item];
+		slot.m_used = false;
+		slot.m_value = Payload{};
+		slot.m_generation++;
+		m_maxGeneration = std::max(m_maxGeneration, slot.m_generation);
+		m_freeItems.push_back(item);
+		TryMerge(node);
+		return true;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool RegionQuadTree<Payload, Coord, LeafCapacity>::Move(Handle handle, const Rect& box) {
+		const auto item = GetItem(handle);
+		if (item == NONE) {
+			return false;
+		}
+		const auto node = m_items[item].m_node;
+		const auto& current = m_nodes[node];
+		// the node is still the smallest one enclosing the item
+		const bool encloses = node == ROOT || current.m_box.Covers(box);
+		if (encloses && (current.IsLeaf() || FindChild(node, box) == NONE)) {
+			m_items[item].m_box = box;
+			return true;
+		}
+		Unlink(item);
+		TryMerge(node);
+		m_items[item].m_box = box;
+		Place(item);
+		return true;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool RegionQuadTree<Payload, Coord, LeafCapacity>::Contains(Handle handle) const noexcept {
+		return GetItem(handle) != NONE;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto RegionQuadTree<Payload, Coord, LeafCapacity>::GetBox(Handle handle) const noexcept -> std::optional<Rect> {
+		const auto item = GetItem(handle);
+		if (item == NONE) {
+			return std::nullopt;
+		}
+		return m_items[item].m_box;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	const Payload* RegionQuadTree<Payload, Coord, LeafCapacity>::Find(Handle handle) const noexcept {
+		const auto item = GetItem(handle);
+		return item == NONE ? nullptr : &m_items[item].m_value;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	Payload* RegionQuadTree<Payload, Coord, LeafCapacity>::Find(Handle handle) noexcept {
+		const auto item = GetItem(handle);
+		return item == NONE ? nullptr : &m_items[item].m_value;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	template<class Visitor>
+	bool RegionQuadTree<Payload, Coord, LeafCapacity>::ForEachAt(const Rect& area, Visitor&& visitor) const {
+		InlineStack<Index, MAX_DEPTH * Cardinals::COUNT> processed;
+		processed.Push(ROOT);
+
+		while (!processed.IsEmpty()) {
+			const Node& current = m_nodes[processed.Pop()];
+			for (auto item = current.m_head; item != NONE; item = m_items[item].m_next) {
+				const Item& slot = m_items[item];
+				if (slot.m_box.Intersect(area) && !detail::Visit(visitor, slot.m_box, slot.m_value, MakeHandle(item))) {
+					return false;
+				}
+			}
+			if (current.IsLeaf()) {
+				continue;
+			}
+			// items of the subtree are inside the box of the child
+			for (Index i = 0; i < Cardinals::COUNT; i++) {
+				const Index child = current.m_firstChild + i;
+				if (m_nodes[child].m_count > 0 && m_nodes[child].m_box.Intersect(area)) {
+					processed.Push(child);
+				}
+			}
+		}
+		return true;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	std::vector<Handle> RegionQuadTree<Payload, Coord, LeafCapacity>::GetItemsAt(const Rect& area) const {
+		std::vector<Handle> items;
+		ForEachAt(area, [&items](const Rect&, const Payload&, Handle handle) {
+			items.push_back(handle);
+		});
+		return items;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	template<class Visitor>
+	bool RegionQuadTree<Payload, Coord, LeafCapacity>::ForEachOverlappingPair(Visitor&& visitor) const {
+		// items of the ancestors which overlap the node followed by own items of the node:
+		// each node appends the candidates for its children to the end
+		std::vector<Candidate> active;
+		active.reserve(std::min<size_t>(GetSize(), MAX_ITEMS * MAX_DEPTH * Cardinals::COUNT));
+		return ForEachOverlappingPair(ROOT, active, 0, visitor);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	template<class Visitor>
+	bool RegionQuadTree<Payload, Coord, LeafCapacity>::ForEachOverlappingPair(
+		Index node, std::vector<Candidate>& active, size_t first, Visitor& visitor
+	) const {
+		const Node& current = m_nodes[node];
+		// [first, own) are the items of the ancestors, [own, last) are the own items
+		const size_t own = active.size();
+		for (auto item = current.m_head; item != NONE; item = m_items[item].m_next) {
+			active.emplace_back(m_items[item].m_box, item);
+		}
+		const size_t last = active.size();
+
+		for (size_t i = own; i < last; i++) {
+			const Candidate candidate = active[i];
+			for (size_t k = first; k < i; k++) {
+				if (active[k].Intersect(candidate)
+					&& !detail::Visit(visitor, MakeHandle(active[k].m_item), MakeHandle(active[i].m_item))
+				) {
+					return false;
+				}
+			}
+		}
+
+		if (!current.IsLeaf()) {
+			for (Index i = 0; i < Cardinals::COUNT; i++) {
+				const Node& child = m_nodes[current.m_firstChild + i];
+				if (child.m_count == 0) {
+					continue;
+				}
+				const Candidate area{ child.m_box, NONE };
+				// only the items overlapping the child can overlap the items of its subtree
+				for (size_t k = first; k < last; k++) {
+					const auto candidate = active[k];
+					if (candidate.Intersect(area)) {
+						active.push_back(candidate);
+					}
+				}
+				const bool proceed = ForEachOverlappingPair(current.m_firstChild + i, active, last, visitor);
+				active.erase(active.begin() + last, active.end());
+				if (!proceed) {
+					return false;
+				}
+			}
+		}
+		active.erase(active.begin() + own, active.end());
+		return true;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	template<class Visitor>
+	void RegionQuadTree<Payload, Coord, LeafCapacity>::PreOrderVisit(Visitor&& visitor) const {
+		InlineStack<Index, MAX_DEPTH * Cardinals::COUNT> processed;
+		processed.Push(ROOT);
+		while (!processed.IsEmpty()) {
+			const Node& current = m_nodes[processed.Pop()];
+			visitor(current);
+			if (!current.IsLeaf()) {
+				for (Index i = Cardinals::COUNT; i > 0; i--) {
+					processed.Push(current.m_firstChild + i - 1);
+				}
+			}
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool RegionQuadTree<Payload, Coord, LeafCapacity>::IsEmpty() const noexcept {
+		return m_nodes[ROOT].m_count == 0;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	size_t RegionQuadTree<Payload, Coord, LeafCapacity>::GetSize() const noexcept {
+		return m_nodes[ROOT].m_count;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	size_t RegionQuadTree<Payload, Coord, LeafCapacity>::GetCapacity() const noexcept {
+		return m_nodes.size();
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void RegionQuadTree<Payload, Coord, LeafCapacity>::Clear() {
+		const Rect box = m_nodes[ROOT].m_box;
+		m_nodes.clear();
+		m_nodes.push_back(Node{ box });
+		m_freeNodes.clear();
+		m_items.clear();
+		m_freeItems.clear();
+		// invalidate handles of all of items: new slots get generation none of them has
+		m_firstGeneration = ++m_maxGeneration;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	Handle RegionQuadTree<Payload, Coord, LeafCapacity>::MakeHandle(Index item) const noexcept {
+		Handle handle;
+		handle.m_index = item;
+		handle.m_generation = m_items[item].m_generation;
+		return handle;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto RegionQuadTree<Payload, Coord, LeafCapacity>::GetItem(Handle handle) const noexcept -> Index {
+		if (handle.m_index >= m_items.size()) {
+			return NONE;
+		}
+		const Item& slot = m_items[handle.m_index];
+		return slot.m_used && slot.m_generation == handle.m_generation ? handle.m_index : NONE;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto RegionQuadTree<Payload, Coord, LeafCapacity>::FindChild(Index node, const Rect& box) const noexcept -> Index {
+		const Node& current = m_nodes[node];
+		const auto cardinal = GetQuarter(box.origin, current.m_box);
+		const Index child = current.m_firstChild + static_cast<Index>(cardinal);
+		return m_nodes[child].m_box.Covers(box) ? child : NONE;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void RegionQuadTree<Payload, Coord, LeafCapacity>::Place(Index item) {
+		const Rect& box = m_items[item].m_box;
+		Index node = ROOT;
+		while (!m_nodes[node].IsLeaf()) {
+			const auto child = FindChild(node, box);
+			if (child == NONE) {
+				break;
+			}
+			node = child;
+		}
+		Link(item, node);
+		for (auto ancestor = m_nodes[node].m_parent; ancestor != NONE; ancestor = m_nodes[ancestor].m_parent) {
+			m_nodes[ancestor].m_count++;
+		}
+		const Node& leaf = m_nodes[node];
+		if (leaf.IsLeaf() && leaf.m_size > MAX_ITEMS && leaf.m_depth < MAX_DEPTH) {
+			Split(node);
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void RegionQuadTree<Payload, Coord, LeafCapacity>::Link(Index item, Index node) noexcept {
+		auto& slot = m_items[item];
+		auto& owner = m_nodes[node];
+		slot.m_node = node;
+		slot.m_prev = NONE;
+		slot.m_next = owner.m_head;
+		if (owner.m_head != NONE) {
+			m_items[owner.m_head].m_prev = item;
+		}
+		owner.m_head = item;
+		owner.m_size++;
+		owner.m_count++;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void RegionQuadTree<Payload, Coord, LeafCapacity>::Unlink(Index item) noexcept {
+		auto& slot = m_items[item];
+		auto& owner = m_nodes[slot.m_node];
+		if (slot.m_prev != NONE) {
+			m_items[slot.m_prev].m_next = slot.m_next;
+		}
+		else {
+			owner.m_head = slot.m_next;
+		}
+		if (slot.m_next != NONE) {
+			m_items[slot.m_next].m_prev = slot.m_prev;
+		}
+		owner.m_size--;
+		for (auto node = slot.m_node; node != NONE; node = m_nodes[node].m_parent) {
+			m_nodes[node].m_count--;
+		}
+		slot.m_node = NONE;
+		slot.m_prev = NONE;
+		slot.m_next = NONE;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void RegionQuadTree<Payload, Coord, LeafCapacity>::Split(Index node) {
+		assert(m_nodes[node].IsLeaf() && "Only leaves are split");
+		const auto children = AllocateChildren();
+		// the buffer may have grown
+		const Rect box = m_nodes[node].m_box;
+		const auto depth = m_nodes[node].m_depth + 1;
+		for (Index i = 0; i < Cardinals::COUNT; i++) {
+			auto& child = m_nodes[children + i];
+			child = Node{ GetRect(static_cast<Cardinals>(i), box) };
+			child.m_parent = node;
+			child.m_depth = depth;
+		}
+		m_nodes[node].m_firstChild = children;
+
+		// the items fitting the quarters go down, the rest stay in the node
+		for (auto item = m_nodes[node].m_head; item != NONE; ) {
+			const auto next = m_items[item].m_next;
+			if (const auto child = FindChild(node, m_items[item].m_box); child != NONE) {
+				auto& owner = m_nodes[node];
+				auto& slot = m_items[item];
+				if (slot.m_prev != NONE) {
+					m_items[slot.m_prev].m_next = slot.m_next;
+				}
+				else {
+					owner.m_head = slot.m_next;
+				}
+				if (slot.m_next != NONE) {
+					m_items[slot.m_next].m_prev = slot.m_prev;
+				}
+				// the item stays in the subtree: only the own items of the node change
+				owner.m_size--;
+				Link(item, child);
+			}
+			item = next;
+		}
+		for (Index i = 0; i < Cardinals::COUNT; i++) {
+			const Node& child = m_nodes[children + i];
+			if (child.m_size > MAX_ITEMS && child.m_depth < MAX_DEPTH) {
+				Split(children + i);
+			}
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void RegionQuadTree<Payload, Coord, LeafCapacity>::TryMerge(Index node) {
+		// the leaf itself has nothing to merge: start from its parent
+		if (m_nodes[node].IsLeaf()) {
+			node = m_nodes[node].m_parent;
+		}
+		// merge the highest node which subtree fits one leaf
+		Index merged = NONE;
+		for (; node != NONE && m_nodes[node].m_count <= MAX_ITEMS; node = m_nodes[node].m_parent) {
+			merged = node;
+		}
+		if (merged == NONE || m_nodes[merged].IsLeaf()) {
+			return;
+		}
+
+		// move items of the subtree to the node and release the blocks of the children
+		InlineStack<Index, MAX_DEPTH * Cardinals::COUNT> blocks;
+		blocks.Push(m_nodes[merged].m_firstChild);
+		while (!blocks.IsEmpty()) {
+			const auto block = blocks.Pop();
+			for (Index i = 0; i < Cardinals::COUNT; i++) {
+				const Node& child = m_nodes[block + i];
+				for (auto item = child.m_head; item != NONE; ) {
+					const auto next = m_items[item].m_next;
+					Link(item, merged);
+					m_nodes[merged].m_count--;
+					item = next;
+				}
+				if (!child.IsLeaf()) {
+					blocks.Push(child.m_firstChild);
+				}
+			}
+			m_freeNodes.push_back(block);
+		}
+		m_nodes[merged].m_firstChild = NONE;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto RegionQuadTree<Payload, Coord, LeafCapacity>::AllocateChildren() -> Index {
+		if (!m_freeNodes.empty()) {
+			const auto block = m_freeNodes.back();
+			m_freeNodes.pop_back();
+			return block;
+		}
+		const auto block = static_cast<Index>(m_nodes.size());
+		m_nodes.resize(m_nodes.size() + Cardinals::COUNT, Node{ m_nodes[ROOT].m_box });
+		return block;
+	}
+
+} // namespace tree
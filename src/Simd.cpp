@@ -0,0 +1,262 @@
+#include "Simd.h"
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define QT_SIMD_X86
+	#include <immintrin.h>
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#include <intrin.h>
+	#endif
+#endif
+
+// allow the compiler to use the instruction set in the function only
+#if defined(__GNUC__) || defined(__clang__)
+	#define QT_TARGET(isa) __attribute__((target(isa)))
+#else
+	#define QT_TARGET(isa)
+#endif
+
+namespace {
+
+	using tree::simd::Level;
+
+	Level DetectLevel() noexcept {
+#if defined(QT_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			return Level::AVX2;
+		}
+		if (__builtin_cpu_supports("sse2")) {
+			return Level::SSE;
+		}
+#elif defined(QT_SIMD_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		const int maxLeaf = info[0];
+		__cpuid(info, 1);
+		const bool hasSse2 = (info[3] & (1 << 26)) != 0;
+		// AVX registers must be enabled by OS
+		const bool hasAvx = (info[2] & (1 << 28)) != 0 && (info[2] & (1 << 27)) != 0
+			&& (_xgetbv(0) & 0x6) == 0x6;
+		if (hasAvx && maxLeaf >= 7) {
+			__cpuidex(info, 7, 0);
+			if ((info[1] & (1 << 5)) != 0) {
+				return Level::AVX2;
+			}
+		}
+		if (hasSse2) {
+			return Level::SSE;
+		}
+#endif
+		return Level::SCALAR;
+	}
+
+	const Level supportedLevel{ DetectLevel() };
+	std::atomic<Level> currentLevel{ supportedLevel };
+
+	// process points left after the vector loop which starts at `first`
+	size_t FindInRectTail(
+		const float* xs, const float* ys, size_t first, size_t count, const mt::Rect& area, uint32_t* indices, size_t found
+	) noexcept {
+		for (size_t i = first; i < count; i++) {
+			if (area.Contains(xs[i], ys[i])) {
+				indices[found++] = static_cast<uint32_t>(i);
+			}
+		}
+		return found;
+	}
+
+	size_t FindInCircleTail(
+		const float* xs, const float* ys, size_t first, size_t count, const mt::Pt& center, float squareRadius,
+		uint32_t* indices, size_t found
+	) noexcept {
+		for (size_t i = first; i < count; i++) {
+			const float dx = xs[i] - center.x;
+			const float dy = ys[i] - center.y;
+			if (dx * dx + dy * dy <= squareRadius) {
+				indices[found++] = static_cast<uint32_t>(i);
+			}
+		}
+		return found;
+	}
+
+#ifdef QT_SIMD_X86
+
+	// append indices of the lanes set in the mask without branches
+	inline size_t Compact(unsigned mask, size_t lanes, size_t first, uint32_t* indices, size_t found) noexcept {
+		for (size_t lane = 0; lane < lanes; lane++) {
+			indices[found] = static_cast<uint32_t>(first + lane);
+			found += (mask >> lane) & 1u;
+		}
+		return found;
+	}
+
+	QT_TARGET("sse2")
+	size_t FindInRectSse(
+		const float* xs, const float* ys, size_t count, const mt::Rect& area, uint32_t* indices
+	) noexcept {
+		const __m128 minX = _mm_set1_ps(area.GetMinX());
+		const __m128 minY = _mm_set1_ps(area.GetMinY());
+		const __m128 maxX = _mm_set1_ps(area.GetMaxX());
+		const __m128 maxY = _mm_set1_ps(area.GetMaxY());
+
+		size_t found{ 0 };
+		size_t i{ 0 };
+		for (; i + 4 <= count; i += 4) {
+			const __m128 x = _mm_loadu_ps(xs + i);
+			const __m128 y = _mm_loadu_ps(ys + i);
+			const __m128 inside = _mm_and_ps(
+				_mm_and_ps(_mm_cmpge_ps(x, minX), _mm_cmplt_ps(x, maxX)),
+				_mm_and_ps(_mm_cmpge_ps(y, minY), _mm_cmplt_ps(y, maxY))
+			);
+			found = Compact(static_cast<unsigned>(_mm_movemask_ps(inside)), 4, i, indices, found);
+		}
+		return FindInRectTail(xs, ys, i, count, area, indices, found);
+	}
+
+	QT_TARGET("avx2")
+	size_t FindInRectAvx2(
+		const float* xs, const float* ys, size_t count, const mt::Rect& area, uint32_t* indices
+	) noexcept {
+		const __m256 minX = _mm256_set1_ps(area.GetMinX());
+		const __m256 minY = _mm256_set1_ps(area.GetMinY());
+		const __m256 maxX = _mm256_set1_ps(area.GetMaxX());
+		const __m256 maxY = _mm256_set1_ps(area.GetMaxY());
+
+		size_t found{ 0 };
+		size_t i{ 0 };
+		for (; i + 8 <= count; i += 8) {
+			const __m256 x = _mm256_loadu_ps(xs + i);
+			const __m256 y = _mm256_loadu_ps(ys + i);
+			const __m256 inside = _mm256_and_ps(
+				_mm256_and_ps(_mm256_cmp_ps(x, minX, _CMP_GE_OQ), _mm256_cmp_ps(x, maxX, _CMP_LT_OQ)),
+				_mm256_and_ps(_mm256_cmp_ps(y, minY, _CMP_GE_OQ), _mm256_cmp_ps(y, maxY, _CMP_LT_OQ))
+			);
+			found = Compact(static_cast<unsigned>(_mm256_movemask_ps(inside)), 8, i, indices, found);
+		}
+		return FindInRectTail(xs, ys, i, count, area, indices, found);
+	}
+
+	QT_TARGET("sse2")
+	size_t FindInCircleSse(
+		const float* xs, const float* ys, size_t count, const mt::Pt& center, float squareRadius, uint32_t* indices
+	) noexcept {
+		const __m128 centerX = _mm_set1_ps(center.x);
+		const __m128 centerY = _mm_set1_ps(center.y);
+		const __m128 radius = _mm_set1_ps(squareRadius);
+
+		size_t found{ 0 };
+		size_t i{ 0 };
+		for (; i + 4 <= count; i += 4) {
+			const __m128 dx = _mm_sub_ps(_mm_loadu_ps(xs + i), centerX);
+			const __m128 dy = _mm_sub_ps(_mm_loadu_ps(ys + i), centerY);
+			const __m128 distance = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+			found = Compact(static_cast<unsigned>(_mm_movemask_ps(_mm_cmple_ps(distance, radius))), 4, i, indices, found);
+		}
+		return FindInCircleTail(xs, ys, i, count, center, squareRadius, indices, found);
+	}
+
+	// no FMA: the distance must be rounded the same way as in scalar code
+	QT_TARGET("avx2")
+	size_t FindInCircleAvx2(
+		const float* xs, const float* ys, size_t count, const mt::Pt& center, float squareRadius, uint32_t* indices
+	) noexcept {
+		const __m256 centerX = _mm256_set1_ps(center.x);
+		const __m256 centerY = _mm256_set1_ps(center.y);
+		const __m256 radius = _mm256_set1_ps(squareRadius);
+
+		size_t found{ 0 };
+		size_t i{ 0 };
+		for (; i + 8 <= count; i += 8) {
+			const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(xs + i), centerX);
+			const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ys + i), centerY);
+			const __m256 distance = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+			const __m256 inside = _mm256_cmp_ps(distance, radius, _CMP_LE_OQ);
+			found = Compact(static_cast<unsigned>(_mm256_movemask_ps(inside)), 8, i, indices, found);
+		}
+		return FindInCircleTail(xs, ys, i, count, center, squareRadius, indices, found);
+	}
+
+	// the boxes of four quarters are tested at once, one per lane in order of tree::Cardinals
+	QT_TARGET("sse2")
+	unsigned IntersectQuartersSse(const mt::Rect& box, const mt::Rect& area) noexcept {
+		const float west = box.size.width / 2.f;
+		const float north = box.size.height / 2.f;
+		const float midX = box.origin.x + west;
+		const float midY = box.origin.y + north;
+		const float maxX = midX + (box.size.width - west);
+		const float maxY = midY + (box.size.height - north);
+
+		const __m128 quarterMinX = _mm_setr_ps(box.origin.x, midX, box.origin.x, midX);
+		const __m128 quarterMaxX = _mm_setr_ps(midX, maxX, midX, maxX);
+		const __m128 quarterMinY = _mm_setr_ps(box.origin.y, box.origin.y, midY, midY);
+		const __m128 quarterMaxY = _mm_setr_ps(midY, midY, maxY, maxY);
+
+		const __m128 outside = _mm_or_ps(
+			_mm_or_ps(
+				_mm_cmpgt_ps(quarterMinX, _mm_set1_ps(area.GetMaxX())),
+				_mm_cmpgt_ps(_mm_set1_ps(area.origin.x), quarterMaxX)
+			),
+			_mm_or_ps(
+				_mm_cmpgt_ps(quarterMinY, _mm_set1_ps(area.GetMaxY())),
+				_mm_cmpgt_ps(_mm_set1_ps(area.origin.y), quarterMaxY)
+			)
+		);
+		return ~static_cast<unsigned>(_mm_movemask_ps(outside)) & 0xFu;
+	}
+
+#endif // QT_SIMD_X86
+
+} // namespace {
+
+namespace tree::simd {
+
+	Level GetSupportedLevel() noexcept {
+		return supportedLevel;
+	}
+
+	Level GetLevel() noexcept {
+		return currentLevel.load(std::memory_order_relaxed);
+	}
+
+	void SetLevel(Level level) noexcept {
+		currentLevel = level > supportedLevel ? supportedLevel : level;
+	}
+
+	size_t FindInRect(
+		const float* xs, const float* ys, size_t count, const mt::Rect& area, uint32_t* indices
+	) noexcept {
+#ifdef QT_SIMD_X86
+		switch (GetLevel()) {
+		case Level::AVX2: return FindInRectAvx2(xs, ys, count, area, indices);
+		case Level::SSE: return FindInRectSse(xs, ys, count, area, indices);
+		default: break;
+		}
+#endif
+		return FindInRectTail(xs, ys, 0, count, area, indices, 0);
+	}
+
+	size_t FindInCircle(
+		const float* xs, const float* ys, size_t count, const mt::Pt& center, float squareRadius, uint32_t* indices
+	) noexcept {
+#ifdef QT_SIMD_X86
+		switch (GetLevel()) {
+		case Level::AVX2: return FindInCircleAvx2(xs, ys, count, center, squareRadius, indices);
+		case Level::SSE: return FindInCircleSse(xs, ys, count, center, squareRadius, indices);
+		default: break;
+		}
+#endif
+		return FindInCircleTail(xs, ys, 0, count, center, squareRadius, indices, 0);
+	}
+
+	unsigned IntersectQuarters(const mt::Rect& box, const mt::Rect& area) noexcept {
+#ifdef QT_SIMD_X86
+		if (GetLevel() != Level::SCALAR) {
+			return IntersectQuartersSse(box, area);
+		}
+#endif
+		return IntersectQuarters<float>(box, area);
+	}
+
+} // namespace tree::simd
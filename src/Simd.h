@@ -0,0 +1,125 @@
+#pragma once
+
+#include "healthy.h"
+#include "Cardinals.h"
+#include <cstdint>
+#include <cstddef>
+
+namespace tree::simd {
+
+	/**
+	 * Instruction sets used by the kernels.
+	 * The best one supported by CPU is detected at runtime,
+	 * kernels fall back to scalar code for other types of coordinates and other CPUs.
+	 */
+	enum class Level { SCALAR, SSE, AVX2 };
+
+	// the best level supported by CPU
+	Level GetSupportedLevel() noexcept;
+
+	// the level used by the kernels
+	Level GetLevel() noexcept;
+
+	// use the level (e.g. to compare kernels), unsupported level is replaced by the best supported one
+	void SetLevel(Level level) noexcept;
+
+	/**
+	 * Write indices of points (xs[i], ys[i]) which are in the area to `indices`.
+	 * Return number of written indices.
+	 */
+	template<class Coord>
+	size_t FindInRect(
+		const Coord* xs, const Coord* ys, size_t count, const mt::BasicRect<Coord>& area, uint32_t* indices
+	) noexcept {
+		size_t found{ 0 };
+		for (size_t i = 0; i < count; i++) {
+			if (area.Contains(xs[i], ys[i])) {
+				indices[found++] = static_cast<uint32_t>(i);
+			}
+		}
+		return found;
+	}
+
+	size_t FindInRect(
+		const float* xs, const float* ys, size_t count, const mt::Rect& area, uint32_t* indices
+	) noexcept;
+
+	/**
+	 * Write indices of points (xs[i], ys[i]) which are not farther than sqrt(squareRadius)
+	 * from the center to `indices`. Return number of written indices.
+	 */
+	template<class Coord>
+	size_t FindInCircle(
+		const Coord* xs, const Coord* ys, size_t count, const mt::BasicPt<Coord>& center,
+		SquareDistance_t<Coord> squareRadius, uint32_t* indices
+	) noexcept {
+		size_t found{ 0 };
+		for (size_t i = 0; i < count; i++) {
+			if (GetSquareDistance(mt::BasicPt<Coord>{ xs[i], ys[i] }, center) <= squareRadius) {
+				indices[found++] = static_cast<uint32_t>(i);
+			}
+		}
+		return found;
+	}
+
+	size_t FindInCircle(
+		const float* xs, const float* ys, size_t count, const mt::Pt& center, float squareRadius, uint32_t* indices
+	) noexcept;
+
+	/**
+	 * Return mask of the quarters of the box (see tree::GetRect) which intersect the area:
+	 * bit `i` is set for the quarter `Cardinals(i)`.
+	 */
+	template<class Coord>
+	unsigned IntersectQuarters(const mt::BasicRect<Coord>& box, const mt::BasicRect<Coord>& area) noexcept {
+		const Coord west = box.size.width / Coord(2);
+		const Coord north = box.size.height / Coord(2);
+		const Coord midX = box.origin.x + west;
+		const Coord midY = box.origin.y + north;
+		const Coord maxX = midX + (box.size.width - west);
+		const Coord maxY = midY + (box.size.height - north);
+		const Coord areaMaxX = area.GetMaxX();
+		const Coord areaMaxY = area.GetMaxY();
+		// overlap of the halves along each axis
+		const bool hasWest = !(box.origin.x > areaMaxX || area.origin.x > midX);
+		const bool hasEast = !(midX > areaMaxX || area.origin.x > maxX);
+		const bool hasNorth = !(box.origin.y > areaMaxY || area.origin.y > midY);
+		const bool hasSouth = !(midY > areaMaxY || area.origin.y > maxY);
+		return (hasWest && hasNorth ? 1u : 0u)
+			| (hasEast && hasNorth ? 2u : 0u)
+			| (hasWest && hasSouth ? 4u : 0u)
+			| (hasEast && hasSouth ? 8u : 0u);
+	}
+
+	unsigned IntersectQuarters(const mt::Rect& box, const mt::Rect& area) noexcept;
+
+	// return mask of the quarters of the box divided at the center (see tree::GetRect) which intersect the area
+	template<class Coord>
+	unsigned IntersectQuarters(
+		const mt::BasicRect<Coord>& box, const mt::BasicPt<Coord>& center, const mt::BasicRect<Coord>& area
+	) noexcept {
+		const Coord areaMaxX = area.GetMaxX();
+		const Coord areaMaxY = area.GetMaxY();
+		const bool hasWest = !(box.origin.x > areaMaxX || area.origin.x > center.x);
+		const bool hasEast = !(center.x > areaMaxX || area.origin.x > box.GetMaxX());
+		const bool hasNorth = !(box.origin.y > areaMaxY || area.origin.y > center.y);
+		const bool hasSouth = !(center.y > areaMaxY || area.origin.y > box.GetMaxY());
+		return (hasWest && hasNorth ? 1u : 0u)
+			| (hasEast && hasNorth ? 2u : 0u)
+			| (hasWest && hasSouth ? 4u : 0u)
+			| (hasEast && hasSouth ? 8u : 0u);
+	}
+
+	// return mask of the quarters of the box divided as described by the division which intersect the area
+	template<class Coord>
+	unsigned IntersectQuarters(
+		const mt::BasicRect<Coord>& box, Division division, const mt::BasicPt<Coord>& center, const mt::BasicRect<Coord>& area
+	) noexcept {
+		switch (division) {
+		case Division::CENTER: return IntersectQuarters(box, center, area);
+		case Division::NONE: return box.Intersect(area) ? 1u : 0u;
+		default: return IntersectQuarters(box, area);
+		}
+	}
+
+} // namespace tree::simd
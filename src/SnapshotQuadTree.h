@@ -0,0 +1,643 @@
+#pragma once
+
+#include "QuadTree.h"
+#include "NodePool.h"
+#include <array>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <iterator>
+#include <cassert>
+#include <type_traits>
+#include <utility>
+
+namespace tree {
+
+	/**
+	 * Quad tree which is queried by many threads while one thread modifies it.
+	 *
+	 * Published nodes are never changed: a modification copies the nodes on the path
+	 * from the root to the changed node (copy-on-write) and publishes the new root at once,
+	 * so a reader keeps a consistent snapshot of the tree without any lock.
+	 * Replaced nodes are retired with the epoch of the replacement and freed by the writer
+	 * when no reader which could see them is left (epoch-based reclamation).
+	 *
+	 * Modifications are serialized by the writer's lock, the readers never block.
+	 * Leaves are divided at the middle like QuadTree's: a node at the maximum depth or with too small box
+	 * becomes an overflow leaf. Merging is eager (see MergePolicy::EAGER), handles aren't supported.
+	 *
+	 * @tparam Payload the value stored with each point, must be copyable
+	 * @tparam Coord the type of coordinates, any arithmetic type
+	 * @tparam LeafCapacity maximum number of points kept by a node
+	 */
+	template<class Payload = NoPayload, class Coord = float, size_t LeafCapacity = DEFAULT_LEAF_CAPACITY>
+	class SnapshotQuadTree {
+		static_assert(std::is_arithmetic_v<Coord>, "Coordinates must be of arithmetic type");
+		static_assert(LeafCapacity > 0, "Node must be able to keep at least one point");
+		static_assert(std::is_copy_assignable_v<Payload>, "Nodes are copied on write");
+
+	public:
+		using Node = tree::Node<Payload, Coord, LeafCapacity>;
+		using Point = typename Node::Point;
+		using Rect = typename Node::Rect;
+
+		static constexpr size_t MAX_POINTS{ LeafCapacity };
+		// number of the readers' slots added at once when all of them are taken by alive snapshots
+		static constexpr size_t READERS_PER_BLOCK{ 64 };
+		// number of retired nodes which triggers reclamation
+		static constexpr size_t RECLAIM_THRESHOLD{ 256 };
+
+		/**
+		 * Immutable state of the tree at the moment the snapshot was taken.
+		 * The nodes it refers to aren't freed while it's alive, so it should be short-lived:
+		 * take a snapshot, run the queries, destroy it.
+		 */
+		class Snapshot {
+		public:
+			Snapshot(Snapshot&& other) noexcept;
+
+			Snapshot& operator=(Snapshot&& other) noexcept;
+
+			~Snapshot();
+
+			Snapshot(const Snapshot&) = delete;
+			Snapshot& operator=(const Snapshot&) = delete;
+
+			// return all of points in the area
+			std::vector<Point> GetPointsAt(const Rect& area) const;
+
+			// write all of points in the area to `out` and return the end of the output
+			template<class OutputIt>
+			OutputIt GetPointsAt(const Rect& area, OutputIt out) const;
+
+			/**
+			 * Call `visitor(point, value)` for each point in the area.
+			 * The visitor may return false to stop the traversal early.
+			 * Return false if the traversal was stopped by the visitor.
+			 */
+			template<class Visitor>
+			bool ForEachAt(const Rect& area, Visitor&& visitor) const;
+
+			bool Contains(const Point& point) const noexcept;
+
+			// return the value stored with the point or nullptr if there is no such point
+			const Payload* Find(const Point& point) const noexcept;
+
+		private:
+			friend class SnapshotQuadTree;
+
+			Snapshot(std::atomic<uint64_t>* reader, const Node* root) noexcept;
+
+			// the reader's slot keeping the epoch the snapshot was taken in
+			std::atomic<uint64_t>* m_reader{ nullptr };
+			const Node* m_root{ nullptr };
+		};
+
+		explicit SnapshotQuadTree(const Rect& fullArea, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+		// no snapshot may outlive the tree
+		~SnapshotQuadTree();
+
+		SnapshotQuadTree(const SnapshotQuadTree&) = delete;
+		SnapshotQuadTree& operator=(const SnapshotQuadTree&) = delete;
+
+		// take the snapshot of the latest published state, it's safe to call from any thread
+		Snapshot GetSnapshot() const;
+
+		/**
+		 * Insert the point with the value unless the point is already in the tree.
+		 * Return whether the point was inserted.
+		 */
+		bool Insert(const Point& point, Payload value = {});
+
+		// return whether the point was erased
+		bool Erase(const Point& point);
+
+		// remove all of points, the snapshots taken before keep them
+		void Clear();
+
+		// set the depth of the nodes which aren't divided anymore (see QuadTree::SetSplitPolicy)
+		void SetMaxDepth(size_t maxDepth);
+
+		// set the minimum size of the quarters (see QuadTree::SetMinCellSize)
+		void SetMinCellSize(Coord size);
+
+		// free retired nodes which aren't visible to any snapshot, it's safe to call from any thread
+		void Reclaim();
+
+		// return number of points in the latest published state
+		size_t GetSize() const noexcept;
+
+		bool IsEmpty() const noexcept;
+
+	private:
+		// epoch of the oldest snapshot which may use the reader's slot; 0 when the slot is free
+		struct alignas(64) Reader {
+			std::atomic<uint64_t> m_epoch{ 0 };
+		};
+
+		// slots of the readers, the blocks are appended by the readers and freed with the tree
+		struct ReaderBlock {
+			std::array<Reader, READERS_PER_BLOCK> m_readers;
+			std::atomic<ReaderBlock*> m_next{ nullptr };
+		};
+
+		struct Retired {
+			Node* node;
+			uint64_t epoch;
+		};
+
+		// published node on the way to the point and the quarter of its child on the way
+		struct Step {
+			Node* node;
+			Cardinals cardinal;
+		};
+
+		using Path = InlineStack<Step, QuadTree<Payload, Coord, LeafCapacity>::INLINE_STACK_SIZE>;
+
+		/**
+		 * Return the published node where the point is or should be inserted
+		 * (the overflow leaf keeping it or the node without the child of its quarter)
+		 * or nullptr if the point is outside of the boxes. The nodes above it are pushed to the path.
+		 */
+		Node* Descend(const Point& point, Path& path) const;
+
+		// return the copy of the published node which replaces it
+		Node* Copy(Node* node);
+
+		/**
+		 * Insert the point into the node which isn't published yet and lies at the depth.
+		 * The node is divided like in QuadTree::Insert, so a node at the maximum depth or with too small box
+		 * becomes an overflow leaf. Return false and release the new nodes if the point is lost by rounding.
+		 */
+		bool InsertUnpublished(Node* node, const Point& point, Payload& value, size_t depth);
+
+		/**
+		 * Copy the published nodes of the path replacing their children on the way by the new version
+		 * and return the new root. After erasure the children which became leaves are merged into the copies.
+		 */
+		Node* CopyPath(Path& path, Node* node, bool merge);
+
+		// merge the leaf into the unpublished parent if their points fit it
+		void Merge(Node* parent, size_t quarter, bool isPublished);
+
+		// make the new root visible to the readers and retire replaced nodes
+		void Publish(Node* root);
+
+		// free retired nodes which aren't visible to any snapshot, the caller holds the writer's lock
+		void ReclaimRetired();
+
+		// free the nodes of the subtree immediately
+		void Release(Node* node);
+
+		// retire all of nodes of the published subtree
+		void Retire(Node* node);
+
+	private:
+		mutable ReaderBlock m_readers;
+		std::atomic<uint64_t> m_epoch{ 1 };
+		std::atomic<Node*> m_root{ nullptr };
+		std::atomic<size_t> m_size{ 0 };
+
+		// the writer's state
+		std::mutex m_writer;
+		NodePool<Node> m_pool;
+		size_t m_maxDepth{ DEFAULT_MAX_DEPTH };
+		Coord m_minCellSize{ 0 };
+		// nodes replaced by the modification which isn't published yet
+		std::vector<Node*> m_replaced;
+		// replaced nodes in order of the epochs
+		std::vector<Retired> m_retired;
+	};
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	SnapshotQuadTree<Payload, Coord, LeafCapacity>::Snapshot::Snapshot(
+		std::atomic<uint64_t>* reader, const Node* root
+	) noexcept
+		: m_reader{ reader }
+		, m_root{ root }
+	{
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	SnapshotQuadTree<Payload, Coord, LeafCapacity>::Snapshot::Snapshot(Snapshot&& other) noexcept
+		: m_reader{ std::exchange(other.m_reader, nullptr) }
+		, m_root{ std::exchange(other.m_root, nullptr) }
+	{
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto SnapshotQuadTree<Payload, Coord, LeafCapacity>::Snapshot::operator=(Snapshot&& other) noexcept -> Snapshot& {
+		if (this != &other) {
+			if (m_reader) {
+				m_reader->store(0, std::memory_order_release);
+			}
+			m_reader = std::exchange(other.m_reader, nullptr);
+			m_root = std::exchange(other.m_root, nullptr);
+		}
+		return *this;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	SnapshotQuadTree<Payload, Coord, LeafCapacity>::Snapshot::~Snapshot() {
+		// the nodes are no longer read
+		if (m_reader) {
+			m_reader->store(0, std::memory_order_release);
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto SnapshotQuadTree<Payload, Coord, LeafCapacity>::Snapshot::GetPointsAt(const Rect& area) const -> std::vector<Point> {
+		std::vector<Point> points;
+		GetPointsAt(area, std::back_inserter(points));
+		return points;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	template<class OutputIt>
+	OutputIt SnapshotQuadTree<Payload, Coord, LeafCapacity>::Snapshot::GetPointsAt(const Rect& area, OutputIt out) const {
+		ForEachAt(area, [&out](const Point& point, const Payload&) {
+			*out++ = point;
+		});
+		return out;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	template<class Visitor>
+	bool SnapshotQuadTree<Payload, Coord, LeafCapacity>::Snapshot::ForEachAt(const Rect& area, Visitor&& visitor) const {
+		assert(m_root && "Snapshot was moved");
+		InlineStack<const Node*, QuadTree<Payload, Coord, LeafCapacity>::INLINE_STACK_SIZE> processed;
+		processed.Push(m_root);
+		std::array<uint32_t, MAX_POINTS> found;
+
+		while (!processed.IsEmpty()) {
+			const auto current = processed.Pop();
+
+			const size_t count = simd::FindInRect(current->m_xs.data(), current->m_ys.data(), current->m_size, area, found.data());
+			for (size_t k = 0; k < count; k++) {
+				const auto i = found[k];
+				if (!detail::Visit(visitor, current->GetPoint(i), current->m_values[i])) {
+					return false;
+				}
+			}
+
+			const unsigned quarters = current->IntersectQuarters(area);
+			for (size_t i = 0; i < Cardinals::COUNT; i++) {
+				if (current->m_children[i] && (quarters & (1u << i))) {
+					processed.Push(current->m_children[i]);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool SnapshotQuadTree<Payload, Coord, LeafCapacity>::Snapshot::Contains(const Point& point) const noexcept {
+		return Find(point) != nullptr;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	const Payload* SnapshotQuadTree<Payload, Coord, LeafCapacity>::Snapshot::Find(const Point& point) const noexcept {
+		assert(m_root && "Snapshot was moved");
+		for (const Node* current = m_root; ; ) {
+			// point is outside the boundary
+			if (!current->m_box.Contains(point)) {
+				return nullptr;
+			}
+			if (const auto child = current->m_children[current->GetQuarter(point)]; child != nullptr && !current->KeepsOverflow(point)) {
+				current = child;
+			}
+			else if (const auto index = current->Find(point); index < current->m_size) {
+				return &current->m_values[index];
+			}
+			else {
+				return nullptr;
+			}
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	SnapshotQuadTree<Payload, Coord, LeafCapacity>::SnapshotQuadTree(
+		const Rect& fullArea, std::pmr::memory_resource* resource
+	)
+		: m_pool{ resource }
+	{
+		auto root = m_pool.Acquire();
+		root->m_box = fullArea;
+		m_root.store(root);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	SnapshotQuadTree<Payload, Coord, LeafCapacity>::~SnapshotQuadTree() {
+		for (auto block = &m_readers; block != nullptr; ) {
+			assert(std::all_of(block->m_readers.cbegin(), block->m_readers.cend(), [](const Reader& reader) {
+				return reader.m_epoch.load() == 0;
+			}) && "Snapshot outlives the tree");
+			const auto next = block->m_next.load();
+			if (block != &m_readers) {
+				delete block;
+			}
+			block = next;
+		}
+		// memory is freed by the pool
+		if constexpr (!std::is_trivially_destructible_v<Node>) {
+			for (const auto& retired : m_retired) {
+				m_pool.Release(retired.node);
+			}
+			Release(m_root.load());
+		}
+	}
+
+	/**
+	 * The reader announces the epoch before it loads the root.
+	 * A node retired in epoch `e` was unlinked before the epoch was advanced past `e`,
+	 * so only the readers announced no later than `e` may have seen it.
+	 * When all of the slots are taken the reader appends a new block of them instead of waiting:
+	 * the writer which scanned the slots before the block was appended had published its root
+	 * before the reader loads the root, so the reader doesn't see the nodes that writer frees.
+	 */
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto SnapshotQuadTree<Payload, Coord, LeafCapacity>::GetSnapshot() const -> Snapshot {
+		// readers of different threads start looking for a free slot at different places
+		const size_t first = std::hash<std::thread::id>{}(std::this_thread::get_id()) % READERS_PER_BLOCK;
+		for (auto block = &m_readers; ; ) {
+			for (size_t i = 0; i < READERS_PER_BLOCK; i++) {
+				auto& reader = block->m_readers[(first + i) % READERS_PER_BLOCK].m_epoch;
+				uint64_t free{ 0 };
+				if (reader.load(std::memory_order_relaxed) == 0
+					&& reader.compare_exchange_strong(free, m_epoch.load())
+				) {
+					return Snapshot{ &reader, m_root.load() };
+				}
+			}
+			auto next = block->m_next.load();
+			if (next == nullptr) {
+				// another reader may append its block first, then its block is used
+				auto appended = new ReaderBlock{};
+				if (block->m_next.compare_exchange_strong(next, appended)) {
+					next = appended;
+				}
+				else {
+					delete appended;
+				}
+			}
+			block = next;
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool SnapshotQuadTree<Payload, Coord, LeafCapacity>::Insert(const Point& point, Payload value) {
+		std::lock_guard<std::mutex> lock{ m_writer };
+		Path path;
+		const auto node = Descend(point, path);
+		if (node == nullptr || node->Find(point) < node->m_size) { // point already exist in the tree
+			return false;
+		}
+		auto copy = Copy(node);
+		if (!InsertUnpublished(copy, point, value, path.GetSize())) {
+			// nothing changed: the published tree stays
+			m_pool.Release(copy);
+			m_replaced.clear();
+			return false;
+		}
+		m_size.fetch_add(1, std::memory_order_relaxed);
+		Publish(CopyPath(path, copy, false));
+		return true;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool SnapshotQuadTree<Payload, Coord, LeafCapacity>::Erase(const Point& point) {
+		std::lock_guard<std::mutex> lock{ m_writer };
+		Path path;
+		const auto node = Descend(point, path);
+		if (node == nullptr) {
+			return false;
+		}
+		const auto index = node->Find(point);
+		if (index == node->m_size) {
+			return false;
+		}
+		auto copy = Copy(node);
+		copy->Remove(index);
+		// data of leaves may be extracted to this node now
+		for (size_t i = 0; i < Cardinals::COUNT; i++) {
+			Merge(copy, i, true);
+		}
+		m_size.fetch_sub(1, std::memory_order_relaxed);
+		Publish(CopyPath(path, copy, true));
+		return true;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void SnapshotQuadTree<Payload, Coord, LeafCapacity>::Clear() {
+		std::lock_guard<std::mutex> lock{ m_writer };
+		const auto old = m_root.load();
+		auto root = m_pool.Acquire();
+		root->m_box = old->m_box;
+		Retire(old);
+		m_size.store(0, std::memory_order_relaxed);
+		Publish(root);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void SnapshotQuadTree<Payload, Coord, LeafCapacity>::SetMaxDepth(size_t maxDepth) {
+		std::lock_guard<std::mutex> lock{ m_writer };
+		m_maxDepth = maxDepth;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void SnapshotQuadTree<Payload, Coord, LeafCapacity>::SetMinCellSize(Coord size) {
+		std::lock_guard<std::mutex> lock{ m_writer };
+		m_minCellSize = size;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void SnapshotQuadTree<Payload, Coord, LeafCapacity>::Reclaim() {
+		std::lock_guard<std::mutex> lock{ m_writer };
+		ReclaimRetired();
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void SnapshotQuadTree<Payload, Coord, LeafCapacity>::ReclaimRetired() {
+		uint64_t oldest = m_epoch.load();
+		for (auto block = &m_readers; block != nullptr; block = block->m_next.load()) {
+			for (const auto& reader : block->m_readers) {
+				if (const auto epoch = reader.m_epoch.load(); epoch != 0) {
+					oldest = std::min(oldest, epoch);
+				}
+			}
+		}
+		// no reader announced in the epoch of retirement or earlier
+		auto reclaimed = m_retired.begin();
+		while (reclaimed != m_retired.end() && reclaimed->epoch < oldest) {
+			m_pool.Release(reclaimed->node);
+			reclaimed++;
+		}
+		m_retired.erase(m_retired.begin(), reclaimed);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	size_t SnapshotQuadTree<Payload, Coord, LeafCapacity>::GetSize() const noexcept {
+		return m_size.load(std::memory_order_relaxed);
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool SnapshotQuadTree<Payload, Coord, LeafCapacity>::IsEmpty() const noexcept {
+		return GetSize() == 0;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto SnapshotQuadTree<Payload, Coord, LeafCapacity>::Descend(const Point& point, Path& path) const -> Node* {
+		for (Node* current = m_root.load(); ; ) {
+			// point is outside the boundary
+			if (!current->m_box.Contains(point)) {
+				return nullptr;
+			}
+			const auto cardinal = current->GetQuarter(point);
+			const auto child = current->m_children[cardinal];
+			if (child == nullptr || current->KeepsOverflow(point)) {
+				return current;
+			}
+			path.Push({ current, cardinal });
+			current = child;
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto SnapshotQuadTree<Payload, Coord, LeafCapacity>::Copy(Node* node) -> Node* {
+		auto copy = m_pool.Acquire();
+		*copy = *node;
+		m_replaced.push_back(node);
+		return copy;
+	}
+
+	// the same as QuadTree::Insert: the node and its new children aren't visible to readers
+	template<class Payload, class Coord, size_t LeafCapacity>
+	bool SnapshotQuadTree<Payload, Coord, LeafCapacity>::InsertUnpublished(
+		Node* node, const Point& point, Payload& value, size_t depth
+	) {
+		// the first of the new nodes, the ones below it are new too
+		Node** created{ nullptr };
+		for (Node* current = node; ; depth++) {
+			// point is lost by rounding of the quarter's boundary
+			if (!current->m_box.Contains(point)) {
+				if (created) {
+					Release(std::exchange(*created, nullptr));
+				}
+				return false;
+			}
+			if (current->m_size < MAX_POINTS) {
+				current->Push(point, std::move(value), Handle::NONE);
+				return true;
+			}
+
+			if (current->IsLeaf()) {
+				current->m_division = depth < m_maxDepth && tree::IsDivisible(current->m_box, m_minCellSize)
+					? Division::MIDDLE
+					: Division::NONE;
+			}
+			const auto cardinal = current->GetQuarter(point);
+			auto& quarter = current->m_children[cardinal];
+			assert(quarter == nullptr && "Only leaves are created while the node is unpublished");
+			quarter = m_pool.Acquire();
+			quarter->m_box = current->GetQuarterBox(cardinal);
+			if (created == nullptr) {
+				created = &quarter;
+			}
+
+			// move points which have same quarter to this child node, the overflow leaf keeps its points
+			for (size_t i = 0; current->m_division != Division::NONE && i < current->m_size; ) {
+				if (quarter->m_box.Contains(current->GetPoint(i))) {
+					quarter->Push(current->GetPoint(i), std::move(current->m_values[i]), Handle::NONE);
+					current->Remove(i);
+				}
+				else {
+					i++;
+				}
+			}
+			current = quarter;
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	auto SnapshotQuadTree<Payload, Coord, LeafCapacity>::CopyPath(Path& path, Node* node, bool merge) -> Node* {
+		while (!path.IsEmpty()) {
+			const auto step = path.Pop();
+			auto copy = Copy(step.node);
+			copy->m_children[step.cardinal] = node;
+			if (merge) {
+				// the child may have become a leaf
+				Merge(copy, step.cardinal, false);
+			}
+			node = copy;
+		}
+		return node;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void SnapshotQuadTree<Payload, Coord, LeafCapacity>::Merge(Node* parent, size_t quarter, bool isPublished) {
+		auto& child = parent->m_children[quarter];
+		if (child == nullptr || !child->IsLeaf() || child->m_size + parent->m_size > MAX_POINTS) {
+			return;
+		}
+		// the published child may be read, so its values are copied
+		for (size_t i = 0; i < child->m_size; i++) {
+			parent->Push(child->GetPoint(i), child->m_values[i], Handle::NONE);
+		}
+		if (isPublished) {
+			m_replaced.push_back(child);
+		}
+		else {
+			m_pool.Release(child);
+		}
+		child = nullptr;
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void SnapshotQuadTree<Payload, Coord, LeafCapacity>::Publish(Node* root) {
+		m_root.store(root);
+		// readers announced after this see the new root only
+		const uint64_t epoch = m_epoch.fetch_add(1);
+		for (auto node : m_replaced) {
+			m_retired.push_back({ node, epoch });
+		}
+		m_replaced.clear();
+		if (m_retired.size() >= RECLAIM_THRESHOLD) {
+			ReclaimRetired();
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void SnapshotQuadTree<Payload, Coord, LeafCapacity>::Release(Node* node) {
+		InlineStack<Node*, QuadTree<Payload, Coord, LeafCapacity>::INLINE_STACK_SIZE> pending;
+		pending.Push(node);
+		while (!pending.IsEmpty()) {
+			const auto current = pending.Pop();
+			for (auto child : current->m_children) {
+				if (child) {
+					pending.Push(child);
+				}
+			}
+			m_pool.Release(current);
+		}
+	}
+
+	template<class Payload, class Coord, size_t LeafCapacity>
+	void SnapshotQuadTree<Payload, Coord, LeafCapacity>::Retire(Node* node) {
+		InlineStack<Node*, QuadTree<Payload, Coord, LeafCapacity>::INLINE_STACK_SIZE> pending;
+		pending.Push(node);
+		while (!pending.IsEmpty()) {
+			const auto current = pending.Pop();
+			for (auto child : current->m_children) {
+				if (child) {
+					pending.Push(child);
+				}
+			}
+			m_replaced.push_back(current);
+		}
+	}
+
+} // namespace tree
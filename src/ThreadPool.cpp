@@ -0,0 +1,145 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+	// identify the pool and the queue of the current worker thread
+	thread_local const tree::ThreadPool* currentPool{ nullptr };
+	thread_local size_t currentWorker{ 0 };
+} // namespace {
+
+namespace tree {
+
+	ThreadPool::ThreadPool(size_t threads) {
+		if (threads == 0) {
+			threads = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+		// the last one is the shared queue
+		for (size_t i = 0; i <= threads; i++) {
+			m_queues.push_back(std::make_unique<Queue>());
+		}
+		m_workers.reserve(threads);
+		for (size_t i = 0; i < threads; i++) {
+			m_workers.emplace_back(&ThreadPool::Work, this, i);
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			m_stop = true;
+		}
+		m_wakeUp.notify_all();
+		for (auto& worker : m_workers) {
+			worker.join();
+		}
+	}
+
+	void ThreadPool::Submit(Task_t task) {
+		auto& queue = *m_queues[GetOwnQueue()];
+		{
+			std::lock_guard<std::mutex> lock{ queue.m_mutex };
+			queue.m_tasks.push_back(std::move(task));
+		}
+		{
+			// increment under the lock so sleeping workers can't miss the task
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			m_pending++;
+		}
+		m_wakeUp.notify_one();
+	}
+
+	bool ThreadPool::TryRunPending() {
+		return TryRun(GetOwnQueue());
+	}
+
+	void ThreadPool::Work(size_t worker) {
+		currentPool = this;
+		currentWorker = worker;
+
+		while (true) {
+			if (TryRun(worker)) {
+				continue;
+			}
+			std::unique_lock<std::mutex> lock{ m_mutex };
+			m_wakeUp.wait(lock, [this]() {
+				return m_stop || m_pending > 0;
+			});
+			if (m_stop && m_pending == 0) {
+				break;
+			}
+		}
+	}
+
+	bool ThreadPool::TryRun(size_t own) {
+		Task_t task;
+		// own queue first (newest task), then steal from the others (oldest task)
+		for (size_t i = 0; i < m_queues.size() && !task; i++) {
+			auto& queue = *m_queues[(own + i) % m_queues.size()];
+			std::lock_guard<std::mutex> lock{ queue.m_mutex };
+			if (queue.m_tasks.empty()) {
+				continue;
+			}
+			if (i == 0) {
+				task = std::move(queue.m_tasks.back());
+				queue.m_tasks.pop_back();
+			}
+			else {
+				task = std::move(queue.m_tasks.front());
+				queue.m_tasks.pop_front();
+			}
+			m_pending--;
+		}
+		if (!task) {
+			return false;
+		}
+		task();
+		return true;
+	}
+
+	size_t ThreadPool::GetOwnQueue() const noexcept {
+		return currentPool == this ? currentWorker : m_queues.size() - 1;
+	}
+
+	TaskGroup::TaskGroup(ThreadPool& pool)
+		: m_pool{ pool }
+	{
+	}
+
+	TaskGroup::~TaskGroup() {
+		while (m_running > 0) {
+			if (!m_pool.TryRunPending()) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void TaskGroup::Run(ThreadPool::Task_t task) {
+		m_running++;
+		m_pool.Submit([this, task = std::move(task)]() {
+			try {
+				task();
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock{ m_mutex };
+				if (!m_error) {
+					m_error = std::current_exception();
+				}
+			}
+			m_running--;
+		});
+	}
+
+	void TaskGroup::Wait() {
+		while (m_running > 0) {
+			if (!m_pool.TryRunPending()) {
+				std::this_thread::yield();
+			}
+		}
+		if (m_error) {
+			std::rethrow_exception(std::exchange(m_error, nullptr));
+		}
+	}
+
+} // namespace tree
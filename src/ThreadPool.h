@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tree {
+
+	/**
+	 * Work-stealing thread pool.
+	 *
+	 * Every worker has its own queue: tasks submitted from a worker are pushed to its queue
+	 * and taken back in LIFO order, while idle workers steal the oldest tasks from the others.
+	 * Tasks submitted from outside of the pool go to the shared queue.
+	 */
+	class ThreadPool {
+	public:
+		using Task_t = std::function<void()>;
+
+		// zero means the number of hardware threads
+		explicit ThreadPool(size_t threads = 0);
+
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		void Submit(Task_t task);
+
+		/**
+		 * Run one of pending tasks on the calling thread.
+		 * Return false if there were no tasks to run.
+		 */
+		bool TryRunPending();
+
+		size_t GetThreadCount() const noexcept;
+
+	private:
+
+		struct Queue {
+			std::mutex m_mutex;
+			std::deque<Task_t> m_tasks;
+		};
+
+		void Work(size_t worker);
+
+		bool TryRun(size_t queue);
+
+		// return index of the queue owned by the calling thread or the shared one
+		size_t GetOwnQueue() const noexcept;
+
+	private:
+		// per-worker queues followed by the shared queue
+		std::vector<std::unique_ptr<Queue>> m_queues;
+		std::vector<std::thread> m_workers;
+
+		// number of tasks waiting in the queues
+		std::atomic<size_t> m_pending{ 0 };
+		std::mutex m_mutex;
+		std::condition_variable m_wakeUp;
+		bool m_stop{ false };
+	};
+
+	/**
+	 * Set of tasks running on the pool which can be waited for.
+	 * The waiting thread helps to run pending tasks instead of blocking,
+	 * so tasks of the group may spawn and wait for nested groups.
+	 */
+	class TaskGroup {
+	public:
+		explicit TaskGroup(ThreadPool& pool);
+
+		// wait for remaining tasks
+		~TaskGroup();
+
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup& operator=(const TaskGroup&) = delete;
+
+		void Run(ThreadPool::Task_t task);
+
+		// wait until all of tasks are done and rethrow the first exception thrown by them
+		void Wait();
+
+	private:
+		ThreadPool& m_pool;
+		std::atomic<size_t> m_running{ 0 };
+
+		std::mutex m_mutex;
+		std::exception_ptr m_error;
+	};
+
+
+	inline size_t ThreadPool::GetThreadCount() const noexcept {
+		return m_workers.size();
+	}
+
+} // namespace tree
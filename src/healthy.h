@@ -6,121 +6,126 @@
 
 namespace mt {
 
-	struct Pt {
-		float x, y;
+	template<class T>
+	struct BasicPt {
+		T x, y;
 
-		constexpr Pt(float x_ = -1, float y_ = -1) : x(x_), y(y_) {}
+		constexpr BasicPt(T x_ = T(-1), T y_ = T(-1)) : x(x_), y(y_) {}
 
-		constexpr Pt Negate() const noexcept {
+		constexpr BasicPt Negate() const noexcept {
 			return { -x, -y };
 		}
 
-		constexpr float SquareLength() const noexcept {
+		constexpr T SquareLength() const noexcept {
 			return x * x + y * y;
 		}
 
-		constexpr float ManhDistance(const Pt& pt) const noexcept {
+		constexpr T ManhDistance(const BasicPt& pt) const noexcept {
 			return (pt.x > x ? (pt.x - x) : (x - pt.x)) + (pt.y > y ? (pt.y - y) : (y - pt.y));
 		}
 
-		float Length() const noexcept {
-			return sqrtf(this->SquareLength());
+		T Length() const noexcept {
+			return static_cast<T>(std::sqrt(this->SquareLength()));
 		}
 
-		constexpr float Dot(const Pt& p) const noexcept {
+		constexpr T Dot(const BasicPt& p) const noexcept {
 			return x * p.x + y * p.y;
 		}
 
-		constexpr float operator*(const Pt& rhs) const noexcept {
+		constexpr T operator*(const BasicPt& rhs) const noexcept {
 			return { this->Dot(rhs) };
 		}
 
-		constexpr Pt operator+(const Pt& rhs) const noexcept {
+		constexpr BasicPt operator+(const BasicPt& rhs) const noexcept {
 			return { x + rhs.x, y + rhs.y };
 		}
 
-		constexpr Pt operator-(const Pt& rhs) const noexcept {
+		constexpr BasicPt operator-(const BasicPt& rhs) const noexcept {
 			return { x - rhs.x, y - rhs.y };
 		}
 
-		constexpr Pt operator+(float value) const noexcept {
+		constexpr BasicPt operator+(T value) const noexcept {
 			return { x + value, y + value };
 		}
 
-		constexpr Pt operator-(float value) const noexcept {
+		constexpr BasicPt operator-(T value) const noexcept {
 			return { x - value, y - value };
 		}
 
-		constexpr Pt operator/(float value) const noexcept {
+		constexpr BasicPt operator/(T value) const noexcept {
 			return { x / value, y / value };
 		}
 
-		constexpr Pt operator*(float value) const noexcept {
+		constexpr BasicPt operator*(T value) const noexcept {
 			return { x * value, y * value };
 		}
 
 	};
 
-	constexpr bool operator==(const Pt& lsh, const Pt& rsh) noexcept {
+	template<class T>
+	constexpr bool operator==(const BasicPt<T>& lsh, const BasicPt<T>& rsh) noexcept {
 		return lsh.x == rsh.x && lsh.y == rsh.y;
 	}
 
-	constexpr bool operator!=(const Pt& lsh, const Pt& rsh) noexcept {
+	template<class T>
+	constexpr bool operator!=(const BasicPt<T>& lsh, const BasicPt<T>& rsh) noexcept {
 		return lsh.x != rsh.x || lsh.y != rsh.y;
 	}
 
-	struct Size {
-		float width;
-		float height;
+	template<class T>
+	struct BasicSize {
+		T width;
+		T height;
 
-		constexpr Pt asPt() const noexcept {
+		constexpr BasicPt<T> asPt() const noexcept {
 			return { width, height };
 		}
 	};
 
-	struct Rect {
-		Pt origin;
-		Size size;
+	template<class T>
+	struct BasicRect {
+		BasicPt<T> origin;
+		BasicSize<T> size;
 
-		constexpr Rect(float x, float y, float w, float h)
+		constexpr BasicRect(T x, T y, T w, T h)
 			: origin{ x, y }
 			, size{ w, h }
 		{}
 
-		constexpr Rect(const Pt& pt, const Size& sz)
+		constexpr BasicRect(const BasicPt<T>& pt, const BasicSize<T>& sz)
 			: origin{ pt }
 			, size{ sz }
 		{}
 
-		constexpr float GetMinX() const noexcept {
+		constexpr T GetMinX() const noexcept {
 			return origin.x;
 		}
 
-		constexpr float GetMinY() const noexcept {
+		constexpr T GetMinY() const noexcept {
 			return origin.y;
 		}
 
-		constexpr float GetMidX() const noexcept {
-			return origin.x + size.width / 2.f;
+		constexpr T GetMidX() const noexcept {
+			return origin.x + size.width / T(2);
 		}
 
-		constexpr float GetMidY() const noexcept {
-			return origin.y + size.height / 2.f;
+		constexpr T GetMidY() const noexcept {
+			return origin.y + size.height / T(2);
 		}
 
-		constexpr float GetMaxX() const noexcept {
+		constexpr T GetMaxX() const noexcept {
 			return origin.x + size.width;
 		}
 
-		constexpr float GetMaxY() const noexcept {
+		constexpr T GetMaxY() const noexcept {
 			return origin.y + size.height;
 		}
 
-		constexpr Pt GetMid() const noexcept {
+		constexpr BasicPt<T> GetMid() const noexcept {
 			return { GetMidX(), GetMidY() };
 		}
 
-		constexpr bool Contains(const Pt& pt) const noexcept {
+		constexpr bool Contains(const BasicPt<T>& pt) const noexcept {
 			return (pt.x >= origin.x
 				&& pt.x < GetMaxX()
 				&& pt.y >= origin.y
@@ -128,11 +133,19 @@ namespace mt {
 			);
 		}
 
-		constexpr bool Contains(float x, float y) const noexcept {
+		constexpr bool Contains(T x, T y) const noexcept {
 			return this->Contains({ x, y });
 		}
 
-		constexpr bool Intersect(const Rect& box) const noexcept {
+		// whether every point of the box is in this rectangle
+		constexpr bool Covers(const BasicRect& box) const noexcept {
+			return origin.x <= box.origin.x
+				&& box.GetMaxX() <= GetMaxX()
+				&& origin.y <= box.origin.y
+				&& box.GetMaxY() <= GetMaxY();
+		}
+
+		constexpr bool Intersect(const BasicRect& box) const noexcept {
 			// If one rectangle is on left side of other 
 			if (origin.x > box.GetMaxX() || box.origin.x > GetMaxX())
 				return false;
@@ -146,6 +159,10 @@ namespace mt {
 
 	};
 
+	using Pt = BasicPt<float>;
+	using Size = BasicSize<float>;
+	using Rect = BasicRect<float>;
+
 	namespace Asserts {
 
 		static_assert(Pt{ 1.f, 10.f }.ManhDistance(Pt{ 11.f, -10.f }) == 30.f, "Manheten distance failed");
@@ -160,6 +177,12 @@ namespace mt {
 		static_assert(Rect{ 0.f, 0.f, 10.f, 10.f }.Intersect(Rect{ 5.f, 10.f, 2.f, 2.f }) == true, "Intersect failed a check!");
 		static_assert(Rect{ 0.f, 0.f, 10.f, 10.f }.Intersect(Rect{ 5.f, 5.f, 2.f,  2.f }) == true, "Intersect failed a check!");
 		static_assert(Rect{ 0.f, 0.f, 10.f, 10.f }.Intersect(Rect{ 5.f, 5.f, 20.f, 20.f }) == true, "Intersect failed a check!");
+
+		static_assert(Rect{ 0.f, 0.f, 10.f, 10.f }.Covers(Rect{ 0.f, 5.f, 10.f, 5.f }) == true, "Covers failed a check!");
+		static_assert(Rect{ 0.f, 0.f, 10.f, 10.f }.Covers(Rect{ 5.f, 5.f, 6.f, 2.f }) == false, "Covers failed a check!");
+
+		static_assert(BasicRect<int>{ 0, 0, 5, 5 }.GetMidX() == 2, "GetMidX failed a check!");
+		static_assert(BasicRect<int>{ 0, 0, 5, 5 }.Contains(4, 4) == true, "Contains failed a check!");
 	}
 
 }